@@ -0,0 +1,149 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include "gpio.h"
+#include "timing.h"
+#include "button.h"
+
+static int chipOpen (struct button *b)
+{
+  struct gpioevent_request req ;
+  int chip ;
+
+  chip = open (BUTTON_CHIP, O_RDONLY | O_CLOEXEC) ;
+  if (chip < 0)
+    return -1 ;
+
+  memset (&req, 0, sizeof (req)) ;
+  req.lineoffset  = b->pin ;
+  req.handleflags = GPIOHANDLE_REQUEST_INPUT ;
+  req.eventflags  = GPIOEVENT_REQUEST_BOTH_EDGES ;
+  strncpy (req.consumer_label, "mastermind", sizeof (req.consumer_label) - 1) ;
+
+  if (ioctl (chip, GPIO_GET_LINEEVENT_IOCTL, &req) < 0)
+  {
+    close (chip) ;
+    return -1 ;
+  }
+  close (chip) ;
+
+  b->fd = req.fd ;
+  return fcntl (b->fd, F_SETFL, fcntl (b->fd, F_GETFL) | O_NONBLOCK) ;
+}
+
+static int simOpen (struct button *b)
+{
+  int fds [2] ;
+
+  if (pipe2 (fds, O_NONBLOCK | O_CLOEXEC) != 0)
+    return -1 ;
+
+  b->fd    = fds [0] ;
+  b->simFd = fds [1] ;
+  return 0 ;
+}
+
+/*
+ * Starts watching @pin for edges, through the GPIO character device, or a
+ * pipe when the sim backend is active. gpioSetup() has to have been
+ * called. Returns 0, or -1 with errno set.
+ */
+int buttonOpen (struct button *b, int pin)
+{
+  b->pin   = pin ;
+  b->fd    = -1 ;
+  b->simFd = -1 ;
+
+  if (gpioSimActive)
+    return simOpen (b) ;
+  return chipOpen (b) ;
+}
+
+void buttonClose (struct button *b)
+{
+  if (b->fd >= 0)
+    close (b->fd) ;
+  if (b->simFd >= 0)
+    close (b->simFd) ;
+  b->fd = b->simFd = -1 ;
+}
+
+/*
+ * Takes the next edge if there is one. Returns 1 with @ev filled in, 0 if
+ * nothing is waiting, or -1 on error.
+ */
+int buttonRead (struct button *b, struct buttonEvent *ev)
+{
+  struct gpioevent_data data ;
+  ssize_t n ;
+
+  if (b->simFd >= 0)
+    n = read (b->fd, ev, sizeof (*ev)) ;
+  else
+  {
+    n = read (b->fd, &data, sizeof (data)) ;
+    if (n == sizeof (data))
+    {
+      ev->level  = data.id == GPIOEVENT_EVENT_RISING_EDGE ;
+      ev->timeNs = data.timestamp ;
+      n = sizeof (*ev) ;
+    }
+  }
+
+  if (n == sizeof (*ev))
+    return 1 ;
+  if (n < 0 && (errno == EAGAIN || errno == EINTR))
+    return 0 ;
+  return -1 ;
+}
+
+/*
+ * Like buttonRead(), but sleeps in poll() for up to @timeoutMs (-1 for
+ * ever) until an edge arrives.
+ */
+int buttonWait (struct button *b, struct buttonEvent *ev, int timeoutMs)
+{
+  struct pollfd pfd = { b->fd, POLLIN, 0 } ;
+  int n ;
+
+  n = buttonRead (b, ev) ;
+  if (n != 0)
+    return n ;
+
+  n = poll (&pfd, 1, timeoutMs) ;
+  if (n < 0)
+    return errno == EINTR ? 0 : -1 ;
+  if (n == 0)
+    return 0 ;
+  return buttonRead (b, ev) ;
+}
+
+/*
+ * Sim backend only: presses (@level 1) or releases the button, as if it
+ * happened at @timeNs (0 for now). The pin's level follows, for anything
+ * that still reads it.
+ */
+int buttonSimEdge (struct button *b, int level, uint64_t timeNs)
+{
+  struct buttonEvent ev ;
+
+  if (b->simFd < 0)
+  {
+    errno = ENODEV ;
+    return -1 ;
+  }
+
+  ev.level  = level != 0 ;
+  ev.timeNs = timeNs ? timeNs : timeNowNs () ;
+  gpioSimSetInput (b->pin, ev.level) ;
+
+  return write (b->simFd, &ev, sizeof (ev)) == sizeof (ev) ? 0 : -1 ;
+}
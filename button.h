@@ -0,0 +1,42 @@
+#ifndef BUTTON_H
+#define BUTTON_H
+
+#include <stdint.h>
+
+/*
+ * Edge events from a push button. On the Pi the line is requested from the
+ * GPIO character device, so the kernel catches every edge and timestamps
+ * it however short the press; nothing has to sample the pin. With the sim
+ * backend the events come from a pipe that buttonSimEdge() writes to.
+ *
+ * Either way the events are read from one file descriptor, so a caller can
+ * poll() it together with anything else it waits on.
+ *
+ * Line events are stamped with CLOCK_MONOTONIC, the clock timeNowNs()
+ * reads, on any recent kernel; before 5.7 it was CLOCK_REALTIME, so there
+ * only the gaps between events mean anything.
+ */
+
+#define	BUTTON_CHIP		"/dev/gpiochip0"
+
+struct buttonEvent
+{
+  int      level ;		// 1 for a rising edge, 0 for a falling one
+  uint64_t timeNs ;		// when it happened, on timeNowNs()'s clock
+} ;
+
+struct button
+{
+  int pin ;
+  int fd ;			// line event fd, or the read end of the sim pipe
+  int simFd ;			// write end of the sim pipe, -1 on real hardware
+} ;
+
+int      buttonOpen    (struct button *b, int pin) ;
+void     buttonClose   (struct button *b) ;
+int      buttonRead    (struct button *b, struct buttonEvent *ev) ;
+int      buttonWait    (struct button *b, struct buttonEvent *ev, int timeoutMs) ;
+
+int      buttonSimEdge (struct button *b, int level, uint64_t timeNs) ;
+
+#endif
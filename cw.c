@@ -10,12 +10,25 @@
 #include <time.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <signal.h>
 #include <sys/time.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
 
+#include "gpio.h"
+#include "score.h"
+#include "game.h"
+#include "timing.h"
+#include "lcd.h"
+#include "render.h"
+#include "button.h"
+#include "press.h"
+#include "leds.h"
+#include "loop.h"
+#include "pacing.h"
+
 #define LED 13
 #define LEDR 5
 #define BUTTON 19
@@ -25,46 +38,12 @@
 #define DATA1_PIN 10
 #define DATA2_PIN 27
 #define DATA3_PIN 22
-#define DELAY 200
 
 #ifndef	TRUE
 #define	TRUE	(1==1)
 #define	FALSE	(1==2)
 #endif
 
-#define	PAGE_SIZE		(4*1024)
-#define	BLOCK_SIZE		(4*1024)
-#define	INPUT			 0
-#define	OUTPUT			 1
-#define	LOW			 0
-#define	HIGH			 1
-#define	PI_GPIO_MASK	(0xFFFFFFC0)
-
-#define	LCD_FUNC_F	0x04
-#define	LCD_FUNC_N	0x08
-#define	LCD_FUNC_DL	0x10
-
-#define	LCD_CDSHIFT_RL	0x04
-#define	LCD_BLINK_CTRL		0x01
-#define	LCD_CURSOR_CTRL		0x02
-#define	LCD_DISPLAY_CTRL	0x04
-
-#define	LCD_CLEAR	0x01
-#define	LCD_HOME	0x02
-#define	LCD_ENTRY	0x04
-#define	LCD_CTRL	0x08
-#define	LCD_CDSHIFT	0x10
-#define	LCD_FUNC	0x20
-#define	LCD_CGRAM	0x40
-#define	LCD_DGRAM	0x80
-
-// Bits in the entry register
-
-#define	LCD_ENTRY_SH		0x01
-#define	LCD_ENTRY_ID		0x02
-
-static volatile unsigned int gpiobase ;
-static volatile uint32_t *gpio ;
 
 static unsigned char newChar [8] = 
 {
@@ -89,101 +68,9 @@ static unsigned char hawoNewChar [8] =
   0b11111,
 } ;
 
-struct lcdDataStruct
-{
-  int bits, rows, cols ;
-  int rsPin, strbPin ;
-  int dataPins [8] ;
-  int cx, cy ;
-};
-
-static int lcdControl;
-
-void pinMode(volatile uint32_t *gpio , int pin ,int state) {
-
-    int fSel = (pin/10)*4;  //finds the fsel register
-    int shift= (pin%10)*3;  //finds the position in the calculated register 
-    asm volatile(
-      "\tLDR R1, %[gpio]\n"     //loads gpio
-      "\tADD R0, R1, %[fSel]\n"  
-      "\tLDR R1, [R0, #0]\n"    
-      "\tMOV R2, #0b111\n"
-      "\tLSL R2, %[shift]\n"
-      "\tBIC R1, R1, R2\n"
-      "\tMOV R2, #1\n"
-      "\tLSL R2, %[shift]\n"
-      "\tORR R1, R2\n"
-      "\tSTR R1, [R0, #0]\n"
-      :
-      : [fSel] "r" (fSel) 
-      , [gpio] "m" (gpio)
-      , [shift] "r" (shift)
-      : "r0", "r1", "r2", "cc");
-}    
-/*a function that takes the pointer to the location wherewe have mapped 
- * our gpio register layout, ourpin number for which the value has to be
- *  set and the value */
-void digitalWrite(volatile uint32_t *gpio, int pin, int theValue) {
-  
-  /*checks whether pin lies in SET1/CLR1 or SET2/CLR2 register and this is done using the
-  information that a register can hold values for 32 register only so if the pin is more
-  than 31 it choose SET2/CLR2 depending if the value to be set is 1 or 0 if o then clr is
-  choosen else SET */
-
-	int off;
-	
-	if(pin > 31) {
-		off = (theValue == LOW) ? 11 : 8;
-	} else {
-		off = (theValue == LOW) ? 10 : 7;
-	}    
-	asm volatile (	     
-		"\tLDR R0, %[gpio]\n"
-		"\tADD R0, R0, %[off]\n"   //loads memloc in register
-		"\tMOV R2, #1\n"
-		"\tMOV R1, %[act]\n"
-		"\tAND R1, #31\n"          //puts 1 by using function LSL that shifts  
-		"\tLSL R2, R1\n"           // it left to that many times depending on the pin number
-		"\tSTR R2, [R0, #0]\n"
-		: 
-		: [gpio] "m" (gpio)
-		, [act] "r" (pin)   //pin number
-		, [off] "r" (off*4)
-		: "r0", "r1", "r2", "cc");
-
-}
-/*this function is used to read the value at the selected pin and return the value that
-it reads if there is any kind of input it returns an integer other than 0*/
-int readPin(volatile uint32_t *gpio, int pin) {
-	
-	int off=0,res=0;
-	
-	if(pin > 31) {
-		off =  14 ;
-	} else {
-		off = 13;
-	}  
-  /*arm function that gets the data from either lev1 or lev2
-  once data is loaded we and it with 1 which left shifted
-  by the number of pin. AND is used to convert any number
-  31 to a number smaller than that and once we get the value it returns it*/
-	asm volatile (	     
-		"\tLDR R0, %[gpio]\n"
-		"\tADD R0, R0, %[off]\n"
-		"\tLDR R3, [R0]\n" 
-		"\tMOV R2, #1\n"
-		"\tMOV R1, %[pin]\n"
-		"\tAND R1, #31\n"     
-		"\tLSL R2, R1\n"
-		"\tAND R3, R2\n"
-		"\tMOV %[res], R3\n"
-		: [res] "=r" (res)
-		: [gpio] "m" (gpio)
-		, [pin] "r" (pin)
-		, [off] "r" (off*4)
-		: "r0", "r1", "r2", "r3", "cc");
-	return res;
-}
+// LCD glyphs (lcdGlyphDefine()) marking the exact and near counts of a result
+#define GLYPH_EXACT 0
+#define GLYPH_NEAR  1
 
 int failure (int fatal, const char *message, ...)
 {
@@ -203,448 +90,357 @@ int failure (int fatal, const char *message, ...)
   return 0 ;
 }
 
-void delayMicroseconds (unsigned int howLong)
-{
-  struct timespec sleeper ;
-  unsigned int uSecs = howLong % 1000000 ;
-  unsigned int wSecs = howLong / 1000000 ;
-
-  /**/ if (howLong ==   0)
-    return ;
-#if 0
-  else if (howLong  < 100)
-    delayMicrosecondsHard (howLong) ;
-#endif
-  else
-  {
-    sleeper.tv_sec  = wSecs ;
-    sleeper.tv_nsec = (long)(uSecs * 1000L) ;
-    nanosleep (&sleeper, NULL) ;
-  }
-}
+/*
+ * Feedback presenter. Blinks are queued on the LED engine (leds.c), which
+ * plays them from its own thread so the game loop can go back to reading
+ * the button while the LEDs are still blinking. Everything the game says
+ * goes on one track so it comes out in order; effects that should overlap
+ * it use another. feedbackWait() blocks until everything queued so far
+ * has been shown.
+ */
+static struct pacing pace;
 
-void delay (unsigned int howLong)
-{
-  struct timespec sleeper, dummy ;
+#define FEEDBACK_TRACK 0
+#define EFFECT_TRACK   1
 
-  sleeper.tv_sec  = (time_t)(howLong / 1000) ;
-  sleeper.tv_nsec = (long)(howLong % 1000) * 1000000 ;
+int feedbackStart (void) {
+  return ledsStart();
+}
 
-  nanosleep (&sleeper, &dummy) ;
+/*
+ * Queues @count blinks of @pin. Never waits; if the queue is full the
+ * blinks are dropped.
+ */
+void presentFeedback (int pin, int count) {
+  ledsBlink(FEEDBACK_TRACK, pin, count, pace.blinkOnMs, pace.blinkOffMs);
 }
 
-void strobe (const struct lcdDataStruct *lcd)
-{
-  digitalWrite (gpio, lcd->strbPin, 1) ; delayMicroseconds (50) ;
-  digitalWrite (gpio, lcd->strbPin, 0) ; delayMicroseconds (50) ;
+/*
+ * Plays a score: exact hits on the green LED, a separator on the red one,
+ * then the colour-only hits on green again.
+ */
+void presentScore (struct score s) {
+  presentFeedback(LEDR, s.exact);
+  presentFeedback(LED, 1);
+  presentFeedback(LEDR, s.near);
 }
 
-void sendDataCmd (const struct lcdDataStruct *lcd, unsigned char data)
-{
-  register unsigned char myData = data ;
-  unsigned char          i, d4 ;
-
-  if (lcd->bits == 4)
-  {
-    d4 = (myData >> 4) & 0x0F;
-    for (i = 0 ; i < 4 ; ++i)
-    {
-      digitalWrite (gpio, lcd->dataPins [i], (d4 & 1)) ;
-      d4 >>= 1 ;
-    }
-    strobe (lcd) ;
+/*
+ * Win: the red LED stays lit while the green one blinks @count times,
+ * both on the engine at once.
+ */
+void presentWin (int count) {
+  struct ledStep glow [2] = {
+    { LED, HIGH, count * (pace.blinkOnMs + pace.blinkOffMs) },
+    { LED, LOW,  0 },
+  };
+
+  ledsPlay(EFFECT_TRACK, glow, 2);
+  ledsBlink(FEEDBACK_TRACK, LEDR, count, pace.blinkOnMs, pace.blinkOffMs);
+}
 
-    d4 = myData & 0x0F ;
-    for (i = 0 ; i < 4 ; ++i)
-    {
-      digitalWrite (gpio, lcd->dataPins [i], (d4 & 1)) ;
-      d4 >>= 1 ;
-    }
-  }
-  else
-  {
-    for (i = 0 ; i < 8 ; ++i)
-    {
-      digitalWrite (gpio, lcd->dataPins [i], (myData & 1)) ;
-      myData >>= 1 ;
-    }
-  }
-  strobe (lcd) ;
+void feedbackWait (void) {
+  ledsWait();
 }
 
-void lcdPutCommand (const struct lcdDataStruct *lcd, unsigned char command)
-{
-  digitalWrite (gpio, lcd->rsPin,   0) ;
-  sendDataCmd  (lcd, command) ;
-  delay (2) ;
+
+/*
+ * The button as a player for the strategy interface in game.h, so the
+ * game loop reads a guess the same way whether a person or the solver
+ * is playing. The digits are collected by the round (below) as the
+ * presses come in; next() only hands them over.
+ */
+struct buttonPlayer {
+  int length, numRange;
+  const int *digits;
+};
+
+static int buttonStart(void *state) {
+  return 0;
 }
 
-void lcdPut4Command (const struct lcdDataStruct *lcd, unsigned char command)
-{
-  register unsigned char myCommand = command ;
-  register unsigned char i ;
+static void buttonNext(void *state, int *guess) {
 
-  digitalWrite (gpio, lcd->rsPin,   0) ;
+  struct buttonPlayer *p = state;
 
-  for (i = 0 ; i < 4 ; ++i)
-  {
-    digitalWrite (gpio, lcd->dataPins [i], (myCommand & 1)) ;
-    myCommand >>= 1 ;
-  }
-  strobe (lcd) ;
+  memcpy(guess, p->digits, p->length * sizeof(int));
 }
 
-void lcdHome (struct lcdDataStruct *lcd)
-{
-  lcdPutCommand (lcd, LCD_HOME) ;
-  lcd->cx = lcd->cy = 0 ;
-  delay (5) ;
+static void buttonFeedback(void *state, struct score s) {
 }
 
-void lcdClear (struct lcdDataStruct *lcd)
-{
+static void buttonEnd(void *state) {
+}
+
+void debugMode(int count, int *userInput, int length, int positionMatch, int correctMatch) {
   
-  lcdPutCommand (lcd, LCD_CLEAR) ;
-  lcdPutCommand (lcd, LCD_HOME) ;
-  lcd->cx = lcd->cy = 0 ;
-  delay (5);
+  int x;
+  printf("Guess %d: ", count);
   
+  for(x = 0; x < length; x++) {
+    if(x == length-1) {
+      printf("%d\n", userInput[x]);
+    } else {
+      printf("%d ", userInput[x]);
+    }
+  }
+  
+  printf("Answer:  %d %d\n", positionMatch, correctMatch);
 }
+/*
+ * A game as a state machine on the event loop (loop.c). A round takes a
+ * guess, from the solver at once or digit by digit from button edges and
+ * the press decoder's deadlines, then scores it. The result stays on the
+ * display for the pacing's resultHoldMs and roundPauseMs (pacing.h), but
+ * that is only a deadline: pressing the button starts the next guess
+ * straight away, so a round takes as long as the player does and no
+ * longer. Nothing here sleeps; the LCD and LEDs are queued and drawn by
+ * their own threads.
+ */
+#define ROUND_INPUT  0
+#define ROUND_RESULT 1
+#define ROUND_WON    2
+
+#define CMD_QUIT 'q'
+
+struct round {
+  struct loop loop;
+  struct loopTimer pressTimer, holdTimer;
+  struct lcdRender *render;
+  struct game *game;
+  struct strategy *player;
+  struct button *button;     // NULL when the solver plays
+  struct pressDecoder decoder;
+  int *digits, nDigits;
+  uint64_t windowEnd;        // a digit with no press at all is 0 after this
+  int state, debug, quit;
+};
 
-void lcdPosition (struct lcdDataStruct *lcd, int x, int y)
-{
-  if ((x > lcd->cols) || (x < 0))
-    return ;
-  if ((y > lcd->rows) || (y < 0))
-    return ;
+static void roundScore(struct round *r);
 
-  lcdPutCommand (lcd, x + (LCD_DGRAM | (y>0 ? 0x40 : 0x00))) ;
+// The next time the decoder or the digit window needs a look
+static void digitArm(struct round *r) {
+  uint64_t due = pressIdle(&r->decoder) ? r->windowEnd : pressDeadline(&r->decoder);
 
-  lcd->cx = x ;
-  lcd->cy = y ;
+  // Held down: only the release can finish the digit, and it is an edge
+  if (due == 0) {
+    loopTimerCancel(&r->loop, &r->pressTimer);
+    return;
+  }
+  loopTimerSet(&r->loop, &r->pressTimer, due);
 }
 
-void lcdDisplay (struct lcdDataStruct *lcd, int state)
-{
-  if (state)
-    lcdControl |=  LCD_DISPLAY_CTRL ;
-  else
-    lcdControl &= ~LCD_DISPLAY_CTRL ;
-
-  lcdPutCommand (lcd, LCD_CTRL | lcdControl) ; 
+static void digitBegin(struct round *r) {
+  pressReset(&r->decoder);
+  r->windowEnd = deadlineAfterMs(r->game->numRange * pace.digitWindowMs);
+  digitArm(r);
 }
 
-void lcdCursor (struct lcdDataStruct *lcd, int state)
-{
-  if (state)
-    lcdControl |=  LCD_CURSOR_CTRL ;
-  else
-    lcdControl &= ~LCD_CURSOR_CTRL ;
+static void digitDone(struct round *r, int count) {
+  r->digits[r->nDigits++] = count;
+  presentFeedback(LED, 1); //red light blinks to insure every number
+  presentFeedback(LEDR, count); //green blinks to represent the input number
 
-  lcdPutCommand (lcd, LCD_CTRL | lcdControl) ; 
+  if (r->nDigits < r->game->length) {
+    digitBegin(r);
+    return;
+  }
+  loopTimerCancel(&r->loop, &r->pressTimer);
+  presentFeedback(LED, 2);
+  roundScore(r);
 }
 
-void lcdCursorBlink (struct lcdDataStruct *lcd, int state)
-{
-  if (state)
-    lcdControl |=  LCD_BLINK_CTRL ;
-  else
-    lcdControl &= ~LCD_BLINK_CTRL ;
+static void roundBegin(struct round *r) {
+  loopTimerCancel(&r->loop, &r->holdTimer);
+  r->state = ROUND_INPUT;
+  lcdRenderSubmit (r->render, "Round Started", "Press The Button") ;
 
-  lcdPutCommand (lcd, LCD_CTRL | lcdControl) ; 
-}
-
-void lcdPutchar (struct lcdDataStruct *lcd, unsigned char data)
-{
-  digitalWrite (gpio, lcd->rsPin, 1) ;
-  sendDataCmd  (lcd, data) ;
-
-  if (++lcd->cx == lcd->cols)
-  {
-    lcd->cx = 0 ;
-    if (++lcd->cy == lcd->rows)
-      lcd->cy = 0 ;
-    
-    lcdPutCommand (lcd, lcd->cx + (LCD_DGRAM | (lcd->cy>0 ? 0x40 : 0x00))) ;
+  if (r->button == NULL) {
+    roundScore(r);
+    return;
   }
+  r->nDigits = 0;
+  digitBegin(r);
 }
 
-void lcdPuts (struct lcdDataStruct *lcd, const char *string)
-{
-  while (*string)
-    lcdPutchar (lcd, *string++) ;
-}
 /*
- * This function turns the given LED on, then waits until 300ms before
- * turning it off again. It runs @count number of times.
+ * Scores the guess and puts the result up. A wrong guess leaves the
+ * button live for the next one.
  */
-void bling (int pin, int count) {
-  int y;
-  
-  for(y = 0; y < count; y++){
-    digitalWrite(gpio, pin, 1);
-    delay(300);
-    digitalWrite(gpio, pin, 0);
-    delay(200);
+static void roundScore(struct round *r) {
+  struct game *game = r->game;
+  int length = game->length;
+  int j;
+
+  int userInput[SCORE_MAX_LENGTH];
+  r->player->next(r->player->state, userInput);
+
+  struct score result = gameGuess(game, userInput);
+  presentScore(result);
+  r->player->feedback(r->player->state, result);
+
+  // "Guess <tries>: <exact> <near>", counts behind their glyphs
+  struct lcdLine top, bottom;
+  lcdLineClear(&top);
+  lcdLineStr(&top, "Guess ");
+  lcdLineInt(&top, game->tries);
+  lcdLineStr(&top, ": ");
+  lcdLineChar(&top, LCD_GLYPH(GLYPH_EXACT));
+  lcdLineInt(&top, result.exact);
+  lcdLineChar(&top, ' ');
+  lcdLineChar(&top, LCD_GLYPH(GLYPH_NEAR));
+  lcdLineInt(&top, result.near);
+
+  // The guess itself; past 8 digits it scrolls
+  lcdLineClear(&bottom);
+  for(j = 0; j < length; j++) {
+    lcdLineInt(&bottom, userInput[j]);
+    lcdLineChar(&bottom, ' ');
   }
-}
 
-/*this function takes the length of the sequence and the highest possible
-number that could be read using the button. */
-int *input(int length, int numRange) {
-  
-  int pinLED = LED, pinButton = BUTTON,pinLEDR = LEDR;
-  int fSel, shift, pin,  clrOff, setOff, off;
-  int y,x,j;
-  int *guess = malloc(length * sizeof(int));
-
-  /*a loop that stores the user input into the guess array
-  and starts a timer this timer runs depending on the range
-  the longer the range the longer the timer will run for
-  */
-  for(x=0; x<length; x++){
-    int count=0,prev=0;
-    time_t startT = time(NULL);
-    /*here we initialise prev and count. prev stores if the previous inout was
-    high or low. in every loop the current value is compared with previous
-    value and if they are different then value is checked if it 1 or 0 and depencding
-    on that we increment our count. The inner loop is to to go over and over again the
-    input value to check if its changed or not*/
-    while((time(NULL)-startT) < numRange*1.5) {
-      int curr=0;
-      for (j=0; j<numRange*2; j++) {
-          if (readPin(gpio,19) != 0) {
-            curr=1;
-            if(prev != curr){
-              prev=1;
-            //breaks if input number greater than range
-            if(count >= numRange) {
-              count=numRange;
-              break;
-            } 
-              count++;
-              break;
-            }
-          } else {
-            prev=0;
-          }
-          delay(200);
-      }
-    }
-    guess[x] = count;
-    bling(LED, 1); //red light blinks to insure every number
-    bling(LEDR, count); //green blinks to represent the input number
+  if (r->debug) {
+    debugMode(game->tries, userInput, length, result.exact, result.near);
+  }
+  lcdRenderSubmit (r->render, top.text, bottom.text) ;
+
+  if (game->won) {
+    r->state = ROUND_WON;
+    loopTimerSet(&r->loop, &r->holdTimer, deadlineAfterMs(pace.resultHoldMs));
+  } else {
+    // If the user guess is wrong, blink LED and wait for the next guess
+    presentFeedback(LED,3);
+    r->state = ROUND_RESULT;
+    loopTimerSet(&r->loop, &r->holdTimer, deadlineAfterMs(pace.resultHoldMs + pace.roundPauseMs));
   }
-  
-  bling(LED,2);
-  return guess;
 }
-/*
- * This function compares the secret and input values. It returns the 
- * result as a 3 value array. result[0] is the success and fail flag. 0
- * means the guess was wrong, 1 means the guess was right. result[1] is
- * the number of correct guesses where index[x] == secret[x]. result[2]
- * means the number of input values which are in secret sequence but not
- * in the right order.
- */
-int *compare(int *secret, int *userInput, int length) {
 
-  static int result[3];
-  int correctNumber = 0, positionMatch = 0;
-  int x, y;
-  int forgetSecret[length];
-  int forgetInput[length];
+static void onHold(void *arg) {
+  struct round *r = arg;
 
-  for(x = 0; x < length; x++) {
-    forgetSecret[x] = 0;
-    forgetInput[x] = 0;
-  }
-  /*
-   * Visit x'th index of both input and secret arrays and mark the
-   * values that match. That is the correct guessed values which
-   * are at the right index in the array. We mark it to be never
-   * used again.
-   */
-  for( x = 0; x < length; x++) {
-    if(userInput[x] == secret[x]) {
-      positionMatch++;
-      forgetSecret[x] = forgetInput[x] = 1;
-    }
+  if (r->state == ROUND_RESULT) {
+    roundBegin(r);
+    return;
   }
-  /*
-   * First we check if the x is an index we didn't visit before.
-   * If it isn't, we search for that value in the secret array.
-   * If the value is matched and it wasn't marked before, the
-   * program increments the correctMatches counter and sets a 
-   * flag that no other values should be taken into account for
-   * x'th element from input array.
-   */
-  for(x = 0; x < length; x++) {
-    if(!forgetInput[x]) {
-      int found = 0;
-
-      for(y = 0; y < length; y++) {
-        if ((secret[y] == userInput[x]) && !forgetSecret[y]) {
-          if (!found) {
-            correctNumber++;
-            found = 1;
-          }
-          forgetSecret[y] = 1;
-        }
-      }
-    }
+
+  // Display the success message
+  struct lcdLine attempts;
+  lcdLineClear(&attempts);
+  lcdLineStr(&attempts, "Attempts = ");
+  lcdLineInt(&attempts, r->game->tries);
+
+  lcdRenderSubmit (r->render, "Success", attempts.text) ;
+  printf("Game finished in %d attempts\n", r->game->tries);
+  loopStop(&r->loop);
+}
+
+static void onPressTimer(void *arg) {
+  struct round *r = arg;
+  int count;
+
+  if (pressIdle(&r->decoder) && deadlinePassed(r->windowEnd)) {
+    digitDone(r, 0);
+    return;
   }
-  /* If correct guesses at correct positions are the same as number
-   * of length, that means we have guessed all the colors correctly.
-   * So in that csae, result[0] is set to 1 to be returned.
-   */
-  (positionMatch == length) ? result[0] = 1 : 0;
-  
-  result[1] = positionMatch;
-  result[2] = correctNumber;
-  
-  bling(LEDR, positionMatch);
-  bling(LED,1);
-  
-  bling(LEDR, correctNumber);
-  
-  return result;
+  count = pressTick(&r->decoder, timeNowNs());
+  if (count >= 0)
+    digitDone(r, count);
+  else
+    digitArm(r);
 }
+
 /*
- * Converts an integer into a string. It returns a static variable 
- * (because it is a local variable that we need the value of later in 
- * code). The length of it is 2. One is to store the converted char, the
- * second is the string terminator. It returns a string because it will
- * be used with strcat which requires this to be returned as a string.
+ * Every edge is queued and timestamped by the kernel. One that comes in
+ * while the last result is still up starts the next guess.
  */
-char *intToString(int value) {
+static void onButton(void *arg) {
+  struct round *r = arg;
+  struct buttonEvent ev;
+  int count;
+
+  while (buttonRead(r->button, &ev) > 0) {
+    if (r->state == ROUND_RESULT)
+      roundBegin(r);
+    if (r->state != ROUND_INPUT)
+      continue;
+
+    count = pressEdge(&r->decoder, &ev);
+    if (count >= 0)
+      digitDone(r, count);
+    else
+      digitArm(r);
+  }
+}
 
-  static char tempString[2];
-  sprintf(tempString, "%d", value);
-  tempString[1] = '\0';
+static void onCommand(void *arg, int cmd) {
+  struct round *r = arg;
 
-  return tempString;
+  if (cmd == CMD_QUIT) {
+    r->quit = 1;
+    loopStop(&r->loop);
+  }
 }
 
-void debugMode(int count, int *userInput, int length, int positionMatch, int correctMatch) {
-  
-  int x;
-  printf("Guess %d: ", count);
-  
-  for(x = 0; x < length; x++) {
-    if(x == length-1) {
-      printf("%d\n", userInput[x]);
-    } else {
-      printf("%d ", userInput[x]);
-    }
-  }
-  
-  printf("Answer:  %d %d\n", positionMatch, correctMatch);
+static struct loop *signalLoop;
+
+static void onSignal(int sig) {
+  loopPost(signalLoop, CMD_QUIT);
 }
+
 /* Main ----------------------------------------------------------------------------- */
 int main (int argc, char **argv)
 {
   int pinLED = LED, pinButton = BUTTON,pinLEDR = LEDR;
   int fSel, shift, pin,  clrOff, setOff, off, fd,j;
-  unsigned int howLong = DELAY;
   uint32_t res;
+  int debugArg = FALSE, solverMode = FALSE;
   
-  if (geteuid () != 0)
-    fprintf (stderr, "setup: Must be root. (Did you forget sudo?)\n") ;
-
-  // constants for RPi2
-  gpiobase = 0x3F200000 ;
-
-  // memory mapping 
-  // Open the master /dev/memory device
-  if ((fd = open ("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC) ) < 0)
-    return failure (FALSE, "setup: Unable to open /dev/mem: %s\n", strerror (errno)) ;
-
-  // GPIO:
-  gpio = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, gpiobase) ;
-  if ((int32_t)gpio == -1)
-    return failure (FALSE, "setup: mmap (GPIO) failed: %s\n", strerror (errno)) ;
+  // key=value arguments set the pacing (pacing.h), anything else is the mode.
+  // A preset or file replaces the whole profile, so it goes before the keys.
+  pacingPreset(&pace, "normal");
+  for (j = 1; j < argc; j++) {
+    if (strncmp(argv[j], "pace=", 5) == 0 && pacingArg(&pace, argv[j]) != 0)
+      return failure (TRUE, "setup: bad pacing setting %s\n", argv[j]) ;
+  }
+  for (j = 1; j < argc; j++) {
+    if (strncmp(argv[j], "pace=", 5) == 0)
+      continue;
+    int arg = pacingArg(&pace, argv[j]);
+    if (arg < 0)
+      return failure (TRUE, "setup: bad pacing setting %s\n", argv[j]) ;
+    if (arg > 0 && argv[j][0] == 'd')
+      debugArg = TRUE;
+    if (arg > 0 && argv[j][0] == 's')
+      solverMode = TRUE;
+  }
+  // Nobody is pressing the button in a solver game, so it needn't wait for real time
+  if (pace.fakeClock && solverMode)
+    timeFake (timeNowNs ()) ;
+  
+  // Real registers via /dev/mem on the Pi, or the simulated register file
+  if (gpioSetup (NULL) != 0)
+    return failure (FALSE, "setup: Unable to open GPIO (%s): %s\n", gpioBackendName (), strerror (errno)) ;
 
   // -----------------------------------------------------------------------------
   // setting the mode
-  pinMode(gpio, LED, 1);
-  pinMode(gpio, LEDR, 1);
+  gpioMode(LED, OUTPUT);
+  gpioMode(LEDR, OUTPUT);
+  if (feedbackStart () != 0)
+    return failure (FALSE, "setup: Unable to start feedback thread\n") ;
   
   struct lcdDataStruct *lcd ;
-  int bits, rows, cols, i ;
-  unsigned char func ;
-  struct tm *t ;
-  time_t tim ;
-  char buf [32] ;
   // hard-coded: 16x2 display, using a 4-bit connection
-  bits = 4; 
-  cols = 16; 
-  rows = 2; 
-  // Create a new LCD:
-  lcd = (struct lcdDataStruct *)malloc (sizeof (struct lcdDataStruct)) ;
+  lcd = lcdInit (2, 16, 4, RS_PIN, STRB_PIN, DATA0_PIN, DATA1_PIN, DATA2_PIN, DATA3_PIN) ;
   if (lcd == NULL)
-    return -1 ;
-
-  // hard-wired GPIO pins
-  lcd->rsPin   = RS_PIN ;
-  lcd->strbPin = STRB_PIN ;
-  lcd->bits    = 4 ;
-  lcd->rows    = rows ;  // # of rows on the display
-  lcd->cols    = cols ;  // # of cols on the display
-  lcd->cx      = 0 ;     // x-pos of cursor
-  lcd->cy      = 0 ;     // y-pos of curosr
-
-  lcd->dataPins [0] = DATA0_PIN ;
-  lcd->dataPins [1] = DATA1_PIN ;
-  lcd->dataPins [2] = DATA2_PIN ;
-  lcd->dataPins [3] = DATA3_PIN ;
-
-  digitalWrite (gpio, lcd->rsPin,   0) ; pinMode (gpio, lcd->rsPin,   OUTPUT) ;
-  digitalWrite (gpio, lcd->strbPin, 0) ; pinMode (gpio, lcd->strbPin, OUTPUT) ;
-
-  for (i = 0 ; i < bits ; ++i)
-  {
-    digitalWrite (gpio, lcd->dataPins [i], 0) ;
-    pinMode      (gpio, lcd->dataPins [i], OUTPUT) ;
-  }
-  delay (35) ; // mS
-
-  if (bits == 4)
-  {
-    func = LCD_FUNC | LCD_FUNC_DL ;			// Set 8-bit mode 3 times
-    lcdPut4Command (lcd, func >> 4) ; delay (35) ;
-    lcdPut4Command (lcd, func >> 4) ; delay (35) ;
-    lcdPut4Command (lcd, func >> 4) ; delay (35) ;
-    func = LCD_FUNC ;					// 4th set: 4-bit mode
-    lcdPut4Command (lcd, func >> 4) ; delay (35) ;
-    lcd->bits = 4 ;
-  }
-  else
-  {
-    failure(TRUE, "setup: only 4-bit connection supported\n");
-    func = LCD_FUNC | LCD_FUNC_DL ;
-    lcdPutCommand  (lcd, func     ) ; delay (35) ;
-    lcdPutCommand  (lcd, func     ) ; delay (35) ;
-    lcdPutCommand  (lcd, func     ) ; delay (35) ;
-  }
-
-  if (lcd->rows > 1)
-  {
-    func |= LCD_FUNC_N ;
-    lcdPutCommand (lcd, func) ; delay (35) ;
-  }
-
-  // Rest of the initialisation sequence
-  lcdDisplay     (lcd, TRUE) ;
-  lcdCursor      (lcd, FALSE) ;
-  lcdCursorBlink (lcd, FALSE) ;
-  lcdClear       (lcd) ;
-  lcdPutCommand (lcd, LCD_ENTRY   | LCD_ENTRY_ID) ;    // set entry mode to increment address counter after write
-  lcdPutCommand (lcd, LCD_CDSHIFT | LCD_CDSHIFT_RL) ;  // set display shift to right-to-left
+    return failure (FALSE, "setup: Unable to initialise the LCD\n") ;
+  lcdGlyphDefine (lcd, GLYPH_EXACT, newChar,     '*') ;
+  lcdGlyphDefine (lcd, GLYPH_NEAR,  hawoNewChar, 'o') ;
+  // From here on the render thread owns the display; screens are only queued
+  struct lcdRender render ;
+  if (lcdRenderStart (&render, lcd) != 0)
+    return failure (FALSE, "setup: Unable to start LCD render thread\n") ;
   // -----------------------------------------------------------------------------
   // Initial Welcome screen
-  lcdPosition (lcd, 0, 0) ; lcdPuts (lcd, "MasterMind") ;
-  lcdPosition (lcd, 0, 1) ; lcdPuts (lcd, "") ;
+  lcdRenderSubmit (&render, "MasterMind", "") ;
   int length, numRange, random;
   // Take length and range from user
   printf("Please enter the length\n");
@@ -653,6 +449,20 @@ int main (int argc, char **argv)
   printf("Please enter the numRange\n");
   scanf("%d", &numRange);
   
+  // Codes are packed one digit per nibble, see score.h
+  if (length < 1 || length > SCORE_MAX_LENGTH || numRange < 1 || numRange > SCORE_MAX_RANGE)
+    return failure (TRUE, "setup: length must be 1-%d and numRange 1-%d\n", SCORE_MAX_LENGTH, SCORE_MAX_RANGE) ;
+  
+  // In solver mode the feedback table is built once, before the first round
+  struct button pressButton = { BUTTON, -1, -1 };
+  int digits[SCORE_MAX_LENGTH];
+  struct buttonPlayer button = { length, numRange, digits };
+  struct strategy player = { "button", &button, buttonStart, buttonNext, buttonFeedback, buttonEnd, NULL };
+  if (solverMode && strategyKnuth (&player, length, numRange) != 0)
+    return failure (TRUE, "setup: solver can't handle %d^%d codes\n", numRange, length) ;
+  if (!solverMode && buttonOpen (&pressButton, BUTTON) != 0)
+    return failure (TRUE, "setup: Unable to watch button on %s: %s\n", BUTTON_CHIP, strerror (errno)) ;
+  
   /*
    * We are using uninitialized integer as seed for random because this
    * will point to a random location in the memory everytime, so our
@@ -660,98 +470,65 @@ int main (int argc, char **argv)
    */
   int randSeed;
   srand(randSeed);
-  int secret[length];
+  struct game game;
+  gameInit(&game, length, numRange);
+  gameNewSecret(&game);
   
-  // Populate the secret values
-  for(j = 0; j < length; j++) {
-    secret[j]=rand()%numRange + 1;
-    // If debug mode param is present, display secret
-    if(argc == 2 && argv[1][0] == 'd') {
-      if(j == 0) { printf("Secret: "); }
-      printf("%d\t", secret[j]);
-    }
-  }
-  
-  printf("\nStart pressing the button\n");
-
-  int success = 0, tries = 0;
-  // Keep running the loop until termination flag is received.
-  while (success != 1) {
-    
-    lcdClear(lcd);
-    lcdPosition (lcd, 0, 0) ; lcdPuts (lcd, "Round Started") ;
-    lcdPosition (lcd, 0, 1) ; lcdPuts (lcd, "Press The Button") ;
-    
-    // Process the user input and store it here.
-    int *userInput = input(length, numRange);
-
-    char resultStringTop[13] = "Guess ";
-    tries++;
-    
-    // Compile the string for the top line of LCD 
-    int *result = compare(secret, userInput, length);
-    
-    // Compile the first line of game to be displayed on LCD
-    strcat(resultStringTop, intToString(tries));
-    strcat(resultStringTop, ": ");
-    strcat(resultStringTop, intToString(result[1]));
-    strcat(resultStringTop, " ");
-    strcat(resultStringTop, intToString(result[2]));
-    resultStringTop[12] = '\0';
-    
-    // Compile the string for the bottom line of LCD
-    char *resultStringBottom = malloc(length * sizeof(char));
-    
-    // Compile the user input to be displayed on LCD
+  // If debug mode param is present, display secret
+  if(debugArg) {
+    printf("Secret: ");
     for(j = 0; j < length; j++) {
-      strcat(resultStringBottom, intToString(userInput[j]));
-      strcat(resultStringBottom, " ");
-    }
-    
-    // If user guessed the sequence correctly
-    if(result[0] == 1) {
-      if(argc == 2 && argv[1][0] == 'd') {
-        debugMode(tries, userInput, length, result[1], result[2]);
-      }
-      // Display the success message
-      success = 1;
-      lcdClear(lcd);
-      lcdPosition (lcd, 0, 0) ; lcdPuts (lcd, resultStringTop) ;
-      lcdPosition (lcd, 0, 1) ; lcdPuts (lcd, resultStringBottom) ;
-      delay(3000);
-      
-      char attempts[13] = "Attempts = ";
-      strcat(attempts, intToString(tries));
-      attempts[12] = '\0';
-        
-      lcdClear(lcd);
-      lcdPosition (lcd, 0, 0) ; lcdPuts (lcd, "Success") ;
-      lcdPosition (lcd, 0, 1) ; lcdPuts (lcd, attempts) ;
-      
-      printf("Game finished in %d attempts\n", tries);
-        
-      digitalWrite(gpio, LED, 1);
-      bling(LEDR, 3);
-      digitalWrite(gpio, LED, 0);
-      
-      free(resultStringBottom);
-      free(userInput);
-      break;
+      printf("%d\t", game.secret[j]);
     }
-    if(argc == 2 && argv[1][0] == 'd') {
-      debugMode(tries, userInput, length, result[1], result[2]);
-    }
-    // If the user guess is wrong, update the LCD output and blink LED
-    lcdClear(lcd);
-    lcdPosition (lcd, 0, 0) ; lcdPuts (lcd, resultStringTop) ;
-    lcdPosition (lcd, 0, 1) ; lcdPuts (lcd, resultStringBottom) ;
-    delay(3000);
-
-    bling(LED,3);
-    delay(1000);
-    
   }
   
+  if(!solverMode) {
+    printf("\nStart pressing the button\n");
+  }
+  if (player.start(player.state) != 0)
+    return failure (TRUE, "setup: %s player failed to start\n", player.name) ;
+
+  // From here on the game only moves when the loop runs a handler
+  struct round round = { .render = &render, .game = &game, .player = &player,
+                         .digits = digits, .debug = debugArg || solverMode };
+  if (loopInit(&round.loop) != 0)
+    return failure (TRUE, "setup: Unable to start the event loop: %s\n", strerror (errno)) ;
+  pressInit(&round.decoder, NULL, numRange);
+  loopTimerInit(&round.pressTimer, onPressTimer, &round);
+  loopTimerInit(&round.holdTimer, onHold, &round);
+  loopOnCommand(&round.loop, onCommand, &round);
+  if (!solverMode) {
+    round.button = &pressButton;
+    loopWatch(&round.loop, pressButton.fd, onButton, &round);
+  }
+
+  // Ctrl-C ends the game between handlers, with the LEDs left off
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onSignal;
+  signalLoop = &round.loop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  roundBegin(&round);
+  if (loopRun(&round.loop) != 0)
+    return failure (TRUE, "loop: %s\n", strerror (errno)) ;
+
+  if (!round.quit) {
+    lcdRenderWait(&render);
+    feedbackWait();
+    presentWin(3);
+    feedbackWait();
+  }
+
+  player.end(player.state);
+  strategyFree(&player);
+  buttonClose(&pressButton);
+  lcdRenderStop(&render);
+  ledsStop();
+  GPIO_LOW(LED);
+  GPIO_LOW(LEDR);
+  loopClose(&round.loop);
   free(lcd);
   
 }
@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "score.h"
+#include "game.h"
+
+/*
+ * This function compares the secret and input values. It returns the
+ * number of correct guesses where index[x] == secret[x] as exact, and
+ * the number of input values which are in the secret sequence but not
+ * in the right order as near. The guess was right when exact == length.
+ *
+ * Both sequences are packed into 64-bit words and scored with
+ * scorePacked() from score.h. compare() has no side effects and keeps no
+ * state, so it is safe to call from any thread and in tight loops.
+ */
+struct score compare(const int *secret, const int *userInput, int length) {
+  return scorePacked(packCode(secret, length), packCode(userInput, length));
+}
+
+/*
+ * Sets up a game with no guesses made yet. The secret still has to be
+ * filled in with gameNewSecret() or gameSetSecret().
+ */
+void gameInit(struct game *game, int length, int numRange) {
+  memset(game, 0, sizeof(*game));
+  game->length = length;
+  game->numRange = numRange;
+}
+
+/*
+ * Picks a random secret with rand(); seeding is up to the caller.
+ */
+void gameNewSecret(struct game *game) {
+
+  int j;
+
+  for(j = 0; j < game->length; j++) {
+    game->secret[j] = rand()%game->numRange + 1;
+  }
+  game->tries = 0;
+  game->won = 0;
+}
+
+void gameSetSecret(struct game *game, const int *secret) {
+  memcpy(game->secret, secret, game->length * sizeof(int));
+  game->tries = 0;
+  game->won = 0;
+}
+
+/*
+ * Scores one guess and counts it. The game is won once every digit is
+ * in the right place.
+ */
+struct score gameGuess(struct game *game, const int *guess) {
+
+  struct score result = compare(game->secret, guess, game->length);
+
+  game->tries++;
+  if(result.exact == game->length) {
+    game->won = 1;
+  }
+  return result;
+}
+
+/*
+ * Lets @player play the whole game with no output at all. Returns the
+ * number of guesses it took, or -1 if the player gave up after @maxTries
+ * or couldn't start.
+ */
+int gamePlay(struct game *game, struct strategy *player, int maxTries) {
+
+  int guess[SCORE_MAX_LENGTH];
+
+  if(player->start(player->state) != 0) {
+    return -1;
+  }
+  while(!game->won && game->tries < maxTries) {
+    player->next(player->state, guess);
+    player->feedback(player->state, gameGuess(game, guess));
+  }
+  player->end(player->state);
+
+  return game->won ? game->tries : -1;
+}
@@ -0,0 +1,46 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include "score.h"
+
+/*
+ * The rules of the game, with no hardware attached: a secret of @length
+ * digits from 1 to @numRange, and a count of guesses until one matches.
+ */
+struct game {
+  int length, numRange;
+  int secret[SCORE_MAX_LENGTH];
+  int tries;
+  int won;
+};
+
+/*
+ * Where guesses come from: the button in cw.c, or one of the automatic
+ * players below. start() is called before every game, next() writes one
+ * guess of length digits, feedback() hears how that guess scored and end()
+ * tidies up after the game. free() releases the player itself.
+ */
+struct strategy {
+  const char *name;
+  void *state;
+  int  (*start)(void *state);
+  void (*next)(void *state, int *guess);
+  void (*feedback)(void *state, struct score s);
+  void (*end)(void *state);
+  void (*free)(void *state);
+};
+
+struct score compare(const int *secret, const int *userInput, int length);
+
+void gameInit(struct game *game, int length, int numRange);
+void gameNewSecret(struct game *game);
+void gameSetSecret(struct game *game, const int *secret);
+struct score gameGuess(struct game *game, const int *guess);
+int gamePlay(struct game *game, struct strategy *player, int maxTries);
+
+int strategyKnuth(struct strategy *player, int length, int numRange);
+int strategyConsistent(struct strategy *player, int length, int numRange);
+int strategyByName(struct strategy *player, const char *name, int length, int numRange);
+void strategyFree(struct strategy *player);
+
+#endif
@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "gpio.h"
+
+volatile uint32_t *gpio ;
+int gpioSimActive ;
+
+static const struct gpioBackend *backend ;
+
+/* ------------------------------------------------------- */
+/* mmap backend: the real registers, mapped from /dev/mem */
+
+static volatile uint32_t *mmapOpen (void)
+{
+  void *regs ;
+  int   fd, err ;
+
+  if (geteuid () != 0)
+    fprintf (stderr, "setup: Must be root. (Did you forget sudo?)\n") ;
+
+  // Open the master /dev/memory device
+  if ((fd = open ("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC) ) < 0)
+    return NULL ;
+
+  regs = mmap (0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, GPIO_BASE) ;
+  err  = errno ;
+  close (fd) ;    // the mapping stays valid without the fd
+  errno = err ;
+
+  return (regs == MAP_FAILED) ? NULL : (volatile uint32_t *)regs ;
+}
+
+static void mmapClose (volatile uint32_t *regs)
+{
+  munmap ((void *)regs, BLOCK_SIZE) ;
+}
+
+const struct gpioBackend gpioMmapBackend = { "mmap", mmapOpen, mmapClose } ;
+
+/* ------------------------------------------------------- */
+/* sim backend: a register file in process memory
+ *
+ * Plain stores to GPSET/GPCLR would just sit in memory, so while the sim
+ * backend is active every write goes through gpioSimStore(), which applies
+ * it the way the chip would: GPSETn/GPCLRn change an output latch, and
+ * GPLEVn shows the latch for pins whose GPFSEL says output and the level
+ * set by gpioSimSetInput() for the rest. Anything else is stored as is.
+ * Reads need no help and go straight to the register file. A lock keeps
+ * writes from the feedback thread and the main loop from interleaving.
+ */
+
+static uint32_t        simRegs [GPIO_REGS] ;
+static uint32_t        simOutputs [2] ;
+static uint32_t        simLatch [2] ;	// last GPSET/GPCLR per pin
+static uint32_t        simInputs [2] ;	// levels driven from outside
+static pthread_mutex_t simLock = PTHREAD_MUTEX_INITIALIZER ;
+
+static uint32_t (*simObserver)(void *arg, uint32_t levels, uint32_t inputs) ;
+static void     *simObserverArg ;
+
+// GPLEV shows the latch for output pins and the outside level for inputs
+static void simUpdateLevels (void)
+{
+  int bank ;
+
+  for (bank = 0 ; bank < 2 ; ++bank)
+    simRegs [GPLEV0 + bank] = (simLatch [bank] & simOutputs [bank]) | (simInputs [bank] & ~simOutputs [bank]) ;
+}
+
+static void simUpdateOutputs (void)
+{
+  int pin ;
+
+  simOutputs [0] = simOutputs [1] = 0 ;
+  for (pin = 0 ; pin < 54 ; ++pin)
+    if (((simRegs [GPFSEL0 + pin / 10] >> ((pin % 10) * 3)) & 7) == OUTPUT)
+      simOutputs [pin / 32] |= 1u << (pin & 31) ;
+}
+
+/*
+ * Shows the observer bank 0 whenever its levels change, and takes back the
+ * levels it drives on the input pins, as a device on the bus would.
+ */
+static void simNotify (uint32_t before)
+{
+  if ((simObserver == NULL) || (simRegs [GPLEV0] == before))
+    return ;
+
+  simInputs [0] = simObserver (simObserverArg, simRegs [GPLEV0], simInputs [0]) ;
+  simUpdateLevels () ;
+}
+
+void gpioSimStore (int reg, uint32_t value)
+{
+  uint32_t before ;
+
+  pthread_mutex_lock (&simLock) ;
+  before = simRegs [GPLEV0] ;
+  switch (reg)
+  {
+    case GPSET0: simLatch [0] |=  value ; break ;
+    case GPSET1: simLatch [1] |=  value ; break ;
+    case GPCLR0: simLatch [0] &= ~value ; break ;
+    case GPCLR1: simLatch [1] &= ~value ; break ;
+    default:
+      simRegs [reg] = value ;
+      if (reg < GPFSEL0 + 6)
+        simUpdateOutputs () ;
+  }
+  simUpdateLevels () ;
+  simNotify (before) ;
+  pthread_mutex_unlock (&simLock) ;
+}
+
+/*
+ * Drives the level of a pin from outside, e.g. a simulated button press.
+ * It shows in GPLEV while the pin is an input.
+ */
+void gpioSimSetInput (int pin, int level)
+{
+  uint32_t before ;
+
+  pthread_mutex_lock (&simLock) ;
+  before = simRegs [GPLEV0] ;
+  if (level)
+    simInputs [pin / 32] |=  (1u << (pin & 31)) ;
+  else
+    simInputs [pin / 32] &= ~(1u << (pin & 31)) ;
+  simUpdateLevels () ;
+  simNotify (before) ;
+  pthread_mutex_unlock (&simLock) ;
+}
+
+/*
+ * Attaches a simulated device to bank 0: @observer is called, with the
+ * sim's lock held, every time a level there changes, and returns what the
+ * input pins should read from then on. It must not call back into the
+ * GPIO functions. NULL detaches it.
+ */
+void gpioSimObserve (uint32_t (*observer)(void *arg, uint32_t levels, uint32_t inputs), void *arg)
+{
+  pthread_mutex_lock (&simLock) ;
+  simObserver    = observer ;
+  simObserverArg = arg ;
+  pthread_mutex_unlock (&simLock) ;
+}
+
+int gpioSimLevel (int pin)
+{
+  return (simRegs [GPLEV0 + pin / 32] >> (pin & 31)) & 1 ;
+}
+
+static volatile uint32_t *simOpen (void)
+{
+  pthread_mutex_lock (&simLock) ;
+  memset (simRegs, 0, sizeof (simRegs)) ;
+  simOutputs [0] = simOutputs [1] = 0 ;
+  simLatch   [0] = simLatch   [1] = 0 ;
+  simInputs  [0] = simInputs  [1] = 0 ;
+  pthread_mutex_unlock (&simLock) ;
+  return simRegs ;
+}
+
+static void simClose (volatile uint32_t *regs)
+{
+}
+
+const struct gpioBackend gpioSimBackend = { "sim", simOpen, simClose } ;
+
+/* ------------------------------------------------------- */
+
+#ifdef GPIO_NO_SIM
+static const struct gpioBackend *backends [] = { &gpioMmapBackend } ;
+#else
+static const struct gpioBackend *backends [] = { &gpioMmapBackend, &gpioSimBackend } ;
+#endif
+
+/*
+ * Opens the named backend ("mmap" or "sim") and points gpio at its
+ * register block. NULL means $GPIO_BACKEND, or the platform default.
+ * Calling it again once GPIO is open does nothing. Returns 0 on success,
+ * -1 with errno set on failure.
+ */
+int gpioSetup (const char *name)
+{
+  volatile uint32_t *regs ;
+  unsigned i ;
+
+  if (gpio != NULL)
+    return 0 ;
+
+  if (name == NULL)
+    name = getenv ("GPIO_BACKEND") ;
+  if (name == NULL)
+#if defined(__arm__) || defined(GPIO_NO_SIM)
+    name = "mmap" ;
+#else
+    name = "sim" ;
+#endif
+
+  for (i = 0 ; i < sizeof (backends) / sizeof (backends [0]) ; ++i)
+    if (strcmp (name, backends [i]->name) == 0)
+      break ;
+  if (i == sizeof (backends) / sizeof (backends [0]))
+  {
+    errno = EINVAL ;
+    return -1 ;
+  }
+  backend = backends [i] ;
+
+  if ((regs = backend->open ()) == NULL)
+    return -1 ;
+
+  gpioSimActive = (backend == &gpioSimBackend) ;
+  gpio = regs ;
+  return 0 ;
+}
+
+void gpioClose (void)
+{
+  if (gpio == NULL)
+    return ;
+  backend->close (gpio) ;
+  gpio = NULL ;
+  gpioSimActive = 0 ;
+}
+
+const char *gpioBackendName (void)
+{
+  return (backend != NULL) ? backend->name : "none" ;
+}
+
+/* ------------------------------------------------------- */
+/* Pin access, for callers with a pin number only known at run time. All
+ * three are the inline versions from gpio.h. */
+
+void pinMode (volatile uint32_t *gpio, int pin, int state)
+{
+  gpioMode (pin, state) ;
+}
+
+void digitalWrite (volatile uint32_t *gpio, int pin, int theValue)
+{
+  gpioWrite (pin, theValue != LOW) ;
+}
+
+/*
+ * Returns non-zero if @pin reads high.
+ */
+int readPin (volatile uint32_t *gpio, int pin)
+{
+  return (int)gpioRead (pin) ;
+}
+
+#if defined(__arm__)
+/* ------------------------------------------------------- */
+/* The original inline assembly, kept so gpiobench can compare against
+ * it. Not used by the game any more. */
+
+/*
+ * Sets the function select bits of @pin. Like it always has, this version
+ * selects output whatever @state says.
+ */
+void pinModeAsm(volatile uint32_t *gpio , int pin ,int state) {
+
+    int fSel = (pin/10)*4;  //finds the fsel register
+    int shift= (pin%10)*3;  //finds the position in the calculated register 
+
+    asm volatile(
+      "\tLDR R1, %[gpio]\n"     //loads gpio
+      "\tADD R0, R1, %[fSel]\n"  
+      "\tLDR R1, [R0, #0]\n"    
+      "\tMOV R2, #0b111\n"
+      "\tLSL R2, %[shift]\n"
+      "\tBIC R1, R1, R2\n"
+      "\tMOV R2, #1\n"
+      "\tLSL R2, %[shift]\n"
+      "\tORR R1, R2\n"
+      "\tSTR R1, [R0, #0]\n"
+      :
+      : [fSel] "r" (fSel) 
+      , [gpio] "m" (gpio)
+      , [shift] "r" (shift)
+      : "r0", "r1", "r2", "cc");
+}    
+/*a function that takes the pointer to the location wherewe have mapped 
+ * our gpio register layout, ourpin number for which the value has to be
+ *  set and the value */
+void digitalWriteAsm(volatile uint32_t *gpio, int pin, int theValue) {
+  
+  /*checks whether pin lies in SET1/CLR1 or SET2/CLR2 register and this is done using the
+  information that a register can hold values for 32 register only so if the pin is more
+  than 31 it choose SET2/CLR2 depending if the value to be set is 1 or 0 if o then clr is
+  choosen else SET */
+
+	int off;
+	
+	if(pin > 31) {
+		off = (theValue == LOW) ? 11 : 8;
+	} else {
+		off = (theValue == LOW) ? 10 : 7;
+	}    
+	asm volatile (	     
+		"\tLDR R0, %[gpio]\n"
+		"\tADD R0, R0, %[off]\n"   //loads memloc in register
+		"\tMOV R2, #1\n"
+		"\tMOV R1, %[act]\n"
+		"\tAND R1, #31\n"          //puts 1 by using function LSL that shifts  
+		"\tLSL R2, R1\n"           // it left to that many times depending on the pin number
+		"\tSTR R2, [R0, #0]\n"
+		: 
+		: [gpio] "m" (gpio)
+		, [act] "r" (pin)   //pin number
+		, [off] "r" (off*4)
+		: "r0", "r1", "r2", "cc");
+}
+/*this function is used to read the value at the selected pin and return the value that
+it reads if there is any kind of input it returns an integer other than 0*/
+int readPinAsm(volatile uint32_t *gpio, int pin) {
+	
+	int off=0,res=0;
+	
+	if(pin > 31) {
+		off =  14 ;
+	} else {
+		off = 13;
+	}  
+  /*arm function that gets the data from either lev1 or lev2
+  once data is loaded we and it with 1 which left shifted
+  by the number of pin. AND is used to convert any number
+  31 to a number smaller than that and once we get the value it returns it*/
+	asm volatile (	     
+		"\tLDR R0, %[gpio]\n"
+		"\tADD R0, R0, %[off]\n"
+		"\tLDR R3, [R0]\n" 
+		"\tMOV R2, #1\n"
+		"\tMOV R1, %[pin]\n"
+		"\tAND R1, #31\n"     
+		"\tLSL R2, R1\n"
+		"\tAND R3, R2\n"
+		"\tMOV %[res], R3\n"
+		: [res] "=r" (res)
+		: [gpio] "m" (gpio)
+		, [pin] "r" (pin)
+		, [off] "r" (off*4)
+		: "r0", "r1", "r2", "r3", "cc");
+	return res;
+}
+#endif
@@ -0,0 +1,141 @@
+#ifndef GPIO_H
+#define GPIO_H
+
+#include <stdint.h>
+
+/*
+ * GPIO hardware abstraction. Everything talks to the BCM2835 GPIO register
+ * block through the global gpio pointer; a backend decides what that block
+ * is. "mmap" maps the real registers from /dev/mem, "sim" is a register
+ * file in process memory that models GPFSEL/GPSET/GPCLR/GPLEV, so the game
+ * runs on any Linux host with no Pi attached.
+ *
+ * The backend is chosen by gpioSetup(), or by the GPIO_BACKEND environment
+ * variable when gpioSetup() is given NULL. The default is mmap on ARM and
+ * sim everywhere else. Build with -DGPIO_NO_SIM to leave the sim backend
+ * out; pin writes are then nothing but a store to the register.
+ */
+
+#define	PAGE_SIZE		(4*1024)
+#define	BLOCK_SIZE		(4*1024)
+
+#define	INPUT			 0
+#define	OUTPUT			 1
+
+#define	LOW			 0
+#define	HIGH			 1
+
+// Mask for the bottom 64 pins which belong to the Raspberry Pi
+//	The others are available for the other devices
+#define	PI_GPIO_MASK	(0xFFFFFFC0)
+
+// constants for RPi2
+#define	GPIO_BASE		0x3F200000
+
+// Register offsets in 32-bit words from the start of the block
+#define	GPFSEL0			 0
+#define	GPSET0			 7
+#define	GPSET1			 8
+#define	GPCLR0			10
+#define	GPCLR1			11
+#define	GPLEV0			13
+#define	GPLEV1			14
+
+#define	GPIO_REGS		(BLOCK_SIZE / 4)
+
+struct gpioBackend
+{
+  const char *name ;
+  volatile uint32_t *(*open)  (void) ;
+  void               (*close) (volatile uint32_t *regs) ;
+} ;
+
+extern volatile uint32_t *gpio ;
+extern int gpioSimActive ;
+
+extern const struct gpioBackend gpioMmapBackend ;
+extern const struct gpioBackend gpioSimBackend ;
+
+int         gpioSetup       (const char *backend) ;
+void        gpioClose       (void) ;
+const char *gpioBackendName (void) ;
+
+void pinMode      (volatile uint32_t *gpio, int pin, int state) ;
+void digitalWrite (volatile uint32_t *gpio, int pin, int theValue) ;
+int  readPin      (volatile uint32_t *gpio, int pin) ;
+
+#if defined(__arm__)
+// The original inline assembly versions, kept to benchmark against
+void pinModeAsm      (volatile uint32_t *gpio, int pin, int state) ;
+void digitalWriteAsm (volatile uint32_t *gpio, int pin, int theValue) ;
+int  readPinAsm      (volatile uint32_t *gpio, int pin) ;
+#endif
+
+// Simulated backend only
+void gpioSimStore    (int reg, uint32_t value) ;
+void gpioSimSetInput (int pin, int level) ;
+int  gpioSimLevel    (int pin) ;
+void gpioSimObserve  (uint32_t (*observer)(void *arg, uint32_t levels, uint32_t inputs), void *arg) ;
+
+/* ------------------------------------------------------- */
+/* Inline register access
+ *
+ * Plain C on volatile register pointers, so the compiler can inline and
+ * schedule it. With a constant pin (use the GPIO_* macros) the register
+ * offset and bit mask fold to constants and a write is a single store.
+ */
+
+#define	GPIO_FSEL(pin)		(GPFSEL0 + (pin) / 10)
+#define	GPIO_SHIFT(pin)		(((pin) % 10) * 3)
+#define	GPIO_SET_REG(pin)	(GPSET0 + ((pin) >> 5))
+#define	GPIO_CLR_REG(pin)	(GPCLR0 + ((pin) >> 5))
+#define	GPIO_LEV_REG(pin)	(GPLEV0 + ((pin) >> 5))
+#define	GPIO_BIT(pin)		(1u << ((pin) & 31))
+
+#ifdef GPIO_NO_SIM
+#define	GPIO_SIM_ACTIVE		0
+#else
+#define	GPIO_SIM_ACTIVE		gpioSimActive
+#endif
+
+static inline void gpioStore (int reg, uint32_t value)
+{
+  if (GPIO_SIM_ACTIVE)
+    gpioSimStore (reg, value) ;
+  else
+    gpio [reg] = value ;
+}
+
+static inline void gpioWrite (int pin, int value)
+{
+  gpioStore (value ? GPIO_SET_REG (pin) : GPIO_CLR_REG (pin), GPIO_BIT (pin)) ;
+}
+
+static inline uint32_t gpioRead (int pin)
+{
+  return gpio [GPIO_LEV_REG (pin)] & GPIO_BIT (pin) ;
+}
+
+static inline void gpioMode (int pin, int mode)
+{
+  gpioStore (GPIO_FSEL (pin), (gpio [GPIO_FSEL (pin)] & ~(7u << GPIO_SHIFT (pin))) | ((uint32_t)(mode & 7) << GPIO_SHIFT (pin))) ;
+}
+
+/*
+ * Raises every bank-0 pin in @set and lowers every one in @clr: at most
+ * one GPSET0 and one GPCLR0 store, however many pins change.
+ */
+static inline void gpioWriteMask (uint32_t set, uint32_t clr)
+{
+  if (set)
+    gpioStore (GPSET0, set) ;
+  if (clr)
+    gpioStore (GPCLR0, clr) ;
+}
+
+// Constant-pin forms: GPIO_HIGH (LED) compiles to one store
+#define	GPIO_HIGH(pin)		gpioStore (GPIO_SET_REG (pin), GPIO_BIT (pin))
+#define	GPIO_LOW(pin)		gpioStore (GPIO_CLR_REG (pin), GPIO_BIT (pin))
+#define	GPIO_READ(pin)		gpioRead (pin)
+
+#endif
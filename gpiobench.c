@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "gpio.h"
+
+/*
+ * Times pin writes through each GPIO path: the inline constant-pin macros,
+ * the inline functions with a pin only known at run time, the digitalWrite()
+ * call and, on ARM, the original inline assembly. Output is one
+ * "key: value" per line, times in nanoseconds per write.
+ *
+ *   ./gpiobench [writes]
+ *
+ * Toggles pin 13 (the green LED in cw.c). With the sim backend the writes
+ * go through gpioSimStore(), so the numbers mostly show its locking; the
+ * "store" line clears gpioSimActive for the run to time the bare stores.
+ */
+
+#define BENCH_PIN 13
+
+static double now(void) {
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Keeps the compiler from folding the pin number into the variable-pin loops
+static volatile int benchPin = BENCH_PIN;
+
+static double timeConstant(long writes) {
+
+  double start = now();
+  long i;
+
+  for(i = 0; i < writes; i += 2) {
+    GPIO_HIGH(BENCH_PIN);
+    GPIO_LOW(BENCH_PIN);
+  }
+  return (now() - start) * 1e9 / writes;
+}
+
+static double timeInline(long writes) {
+
+  int pin = benchPin;
+  double start = now();
+  long i;
+
+  for(i = 0; i < writes; i += 2) {
+    gpioWrite(pin, HIGH);
+    gpioWrite(pin, LOW);
+  }
+  return (now() - start) * 1e9 / writes;
+}
+
+static double timeCall(long writes) {
+
+  int pin = benchPin;
+  double start = now();
+  long i;
+
+  for(i = 0; i < writes; i += 2) {
+    digitalWrite(gpio, pin, HIGH);
+    digitalWrite(gpio, pin, LOW);
+  }
+  return (now() - start) * 1e9 / writes;
+}
+
+#if defined(__arm__)
+static double timeAsm(long writes) {
+
+  int pin = benchPin;
+  double start = now();
+  long i;
+
+  for(i = 0; i < writes; i += 2) {
+    digitalWriteAsm(gpio, pin, HIGH);
+    digitalWriteAsm(gpio, pin, LOW);
+  }
+  return (now() - start) * 1e9 / writes;
+}
+#endif
+
+int main(int argc, char **argv) {
+
+  long writes = 10000000;
+
+  if(argc >= 2) {
+    writes = atol(argv[1]);
+  }
+  if(writes < 2) {
+    fprintf(stderr, "writes must be at least 2\n");
+    return 1;
+  }
+  if(gpioSetup(NULL) != 0) {
+    perror("gpioSetup");
+    return 1;
+  }
+  gpioMode(BENCH_PIN, OUTPUT);
+
+  printf("backend: %s\n", gpioBackendName());
+  printf("writes: %ld\n", writes);
+  printf("constant_ns: %.2f\n", timeConstant(writes));
+  printf("inline_ns: %.2f\n", timeInline(writes));
+  printf("call_ns: %.2f\n", timeCall(writes));
+#if defined(__arm__)
+  printf("asm_ns: %.2f\n", timeAsm(writes));
+#else
+  printf("asm_ns: n/a\n");
+#endif
+  if(gpioSimActive) {
+    gpioSimActive = 0;
+    printf("store_ns: %.2f\n", timeConstant(writes));
+    gpioSimActive = 1;
+  }
+
+  gpioWrite(BENCH_PIN, LOW);
+  gpioClose();
+  return 0;
+}
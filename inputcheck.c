@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "gpio.h"
+#include "timing.h"
+#include "button.h"
+#include "press.h"
+#include "loop.h"
+#include "pacing.h"
+
+/*
+ * Checks the input timing cw.c gets from the event loop (loop.c) and the
+ * press decoder (press.c). A digit is read the way a round reads one,
+ * with button edges played in from the sim backend at set times, and
+ * each case checks which digit came out and when. Output is one
+ * "key: value" per line, and the exit status is 1 if any case failed.
+ *
+ *   ./inputcheck
+ *
+ * The digit cases run on the fake clock, so their times are exact: with
+ * no press the digit is 0 after numRange times the normal pacing's
+ * digitWindowMs, and after the last release it is entered PRESS_GAP_MS
+ * later.
+ */
+
+#define BUTTON_PIN 19
+#define NUM_RANGE  6
+
+#define MS 1000000ULL
+
+// A handler that fires this often without time moving on has the loop stuck
+#define CHECK_MAX_FIRES 10000
+
+struct edge {
+  unsigned ms;
+  int level;
+};
+
+struct check {
+  struct loop loop;
+  struct loopTimer pressTimer, edgeTimer, probeTimer, stopTimer;
+  struct button button;
+  struct pressDecoder decoder;
+  uint64_t start, windowEnd;
+  const struct edge *edges;
+  int nEdges, nextEdge;
+  int digit, fires, stuck;
+  uint64_t digitAt, probeAt;
+};
+
+static struct pacing pace;
+
+static double msSince(uint64_t start) {
+  return (timeNowNs() - start) / 1e6;
+}
+
+// As digitArm() in cw.c
+static void checkArm(struct check *c) {
+  uint64_t due = pressIdle(&c->decoder) ? c->windowEnd : pressDeadline(&c->decoder);
+
+  if (due == 0) {
+    loopTimerCancel(&c->loop, &c->pressTimer);
+    return;
+  }
+  loopTimerSet(&c->loop, &c->pressTimer, due);
+}
+
+static void checkDigit(struct check *c, int count) {
+  c->digit = count;
+  c->digitAt = timeNowNs();
+  loopStop(&c->loop);
+}
+
+// As onPressTimer() in cw.c
+static void onPressTimer(void *arg) {
+
+  struct check *c = arg;
+  int count;
+
+  if (++c->fires > CHECK_MAX_FIRES) {
+    c->stuck = 1;
+    loopStop(&c->loop);
+    return;
+  }
+  if (pressIdle(&c->decoder) && deadlinePassed(c->windowEnd)) {
+    checkDigit(c, 0);
+    return;
+  }
+  count = pressTick(&c->decoder, timeNowNs());
+  if (count >= 0) {
+    checkDigit(c, count);
+  } else {
+    checkArm(c);
+  }
+}
+
+// As onButton() in cw.c
+static void onButton(void *arg) {
+
+  struct check *c = arg;
+  struct buttonEvent ev;
+  int count;
+
+  while (buttonRead(&c->button, &ev) > 0) {
+    count = pressEdge(&c->decoder, &ev);
+    if (count >= 0) {
+      checkDigit(c, count);
+    } else {
+      checkArm(c);
+    }
+  }
+}
+
+// Plays the next scripted edge into the button
+static void onEdge(void *arg) {
+
+  struct check *c = arg;
+
+  buttonSimEdge(&c->button, c->edges[c->nextEdge].level, timeNowNs());
+  if (++c->nextEdge < c->nEdges) {
+    loopTimerSet(&c->loop, &c->edgeTimer, c->start + c->edges[c->nextEdge].ms * MS);
+  }
+}
+
+static void onProbe(void *arg) {
+
+  struct check *c = arg;
+
+  c->probeAt = timeNowNs();
+}
+
+static void onStop(void *arg) {
+
+  struct check *c = arg;
+
+  loopStop(&c->loop);
+}
+
+/*
+ * Reads one digit with @edges played in, and checks it comes out as
+ * @digit after @digitMs. If @probeMs isn't 0, a timer set for then has
+ * to fire on time too, while the digit is still being read.
+ */
+static int checkInput(const char *name, const struct edge *edges, int nEdges, unsigned probeMs, int digit, unsigned digitMs) {
+
+  struct check c;
+  int ok;
+
+  memset(&c, 0, sizeof(c));
+  c.digit = -1;
+  c.edges = edges;
+  c.nEdges = nEdges;
+
+  timeFake(1000000000ULL);
+  if(loopInit(&c.loop) != 0 || buttonOpen(&c.button, BUTTON_PIN) != 0) {
+    perror(name);
+    timeReal();
+    return 0;
+  }
+  loopWatch(&c.loop, c.button.fd, onButton, &c);
+  loopTimerInit(&c.pressTimer, onPressTimer, &c);
+  loopTimerInit(&c.edgeTimer, onEdge, &c);
+  loopTimerInit(&c.probeTimer, onProbe, &c);
+  loopTimerInit(&c.stopTimer, onStop, &c);
+
+  c.start = timeNowNs();
+  pressInit(&c.decoder, NULL, NUM_RANGE);
+  c.windowEnd = deadlineAfterMs(NUM_RANGE * pace.digitWindowMs);
+  checkArm(&c);
+  if(nEdges > 0) {
+    loopTimerSet(&c.loop, &c.edgeTimer, c.start + edges[0].ms * MS);
+  }
+  if(probeMs > 0) {
+    loopTimerSet(&c.loop, &c.probeTimer, c.start + probeMs * MS);
+  }
+  // Well past anything a case waits for, so a missed deadline fails instead of hanging
+  loopTimerSet(&c.loop, &c.stopTimer, c.start + 60000 * MS);
+
+  loopRun(&c.loop);
+
+  ok = !c.stuck && c.digit == digit && c.digitAt - c.start == digitMs * MS;
+  if(probeMs > 0) {
+    ok &= c.probeAt - c.start == probeMs * MS;
+  }
+  printf("%s_digit: %d\n", name, c.digit);
+  printf("%s_ms: %.3f\n", name, c.digit >= 0 ? (c.digitAt - c.start) / 1e6 : 0.0);
+  if(probeMs > 0) {
+    printf("%s_probe_ms: %.3f\n", name, c.probeAt ? (c.probeAt - c.start) / 1e6 : 0.0);
+  }
+  printf("%s_ok: %d\n", name, ok);
+
+  buttonClose(&c.button);
+  loopClose(&c.loop);
+  timeReal();
+  return ok;
+}
+
+struct spin {
+  struct loop loop;
+  struct loopTimer spinTimer, stopTimer;
+  int fires, command;
+};
+
+static void onSpin(void *arg) {
+
+  struct spin *s = arg;
+
+  s->fires++;
+  loopTimerSet(&s->loop, &s->spinTimer, 0);
+}
+
+static void onSpinStop(void *arg) {
+
+  struct spin *s = arg;
+
+  loopStop(&s->loop);
+}
+
+static void onSpinCommand(void *arg, int cmd) {
+
+  struct spin *s = arg;
+
+  s->command = cmd;
+}
+
+/*
+ * A handler that keeps setting its timer for a deadline that has passed
+ * must still let the loop poll: a posted command is handled and a later
+ * timer fires. Runs on the real clock, for 20ms.
+ */
+static int checkSpin(void) {
+
+  struct spin s;
+  uint64_t start;
+  int ok;
+
+  memset(&s, 0, sizeof(s));
+  if(loopInit(&s.loop) != 0) {
+    perror("spin");
+    return 0;
+  }
+  loopOnCommand(&s.loop, onSpinCommand, &s);
+  loopTimerInit(&s.spinTimer, onSpin, &s);
+  loopTimerInit(&s.stopTimer, onSpinStop, &s);
+
+  start = timeNowNs();
+  loopTimerSet(&s.loop, &s.spinTimer, 0);
+  loopTimerSet(&s.loop, &s.stopTimer, deadlineAfterMs(20));
+  loopPost(&s.loop, 'x');
+  loopRun(&s.loop);
+
+  ok = s.command == 'x' && s.fires > 1 && msSince(start) >= 20;
+  printf("spin_fires: %d\n", s.fires);
+  printf("spin_ms: %.3f\n", msSince(start));
+  printf("spin_ok: %d\n", ok);
+
+  loopClose(&s.loop);
+  return ok;
+}
+
+int main(void) {
+
+  // Two short presses, the last let go at 400ms
+  static const struct edge gap[] = { { 100, 1 }, { 200, 0 }, { 300, 1 }, { 400, 0 } };
+  // Pressed at 100ms and held: long, so released at 1000ms it is a digit at once
+  static const struct edge held[] = { { 100, 1 }, { 1000, 0 } };
+  int ok = 1;
+
+  pacingPreset(&pace, "normal");
+
+  if(gpioSetup("sim") != 0) {
+    perror("gpioSetup");
+    return 1;
+  }
+
+  ok &= checkSpin();
+  ok &= checkInput("window", NULL, 0, 0, 0, NUM_RANGE * pace.digitWindowMs);
+  ok &= checkInput("gap", gap, 4, 0, 2, 400 + PRESS_GAP_MS);
+  ok &= checkInput("held", held, 2, 500, 1, 1000);
+
+  printf("ok: %d\n", ok);
+  gpioClose();
+  return ok ? 0 : 1;
+}
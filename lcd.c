@@ -0,0 +1,654 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpio.h"
+#include "timing.h"
+#include "lcd.h"
+
+static int lcdControl;
+
+/*
+ * The fixed waits are the datasheet worst cases: 50uS after every strobe,
+ * 2mS after a command and 5mS more after clear or home. With R/W wired the
+ * driver reads the busy flag instead and waits only as long as the
+ * controller needs; the enable pulse then only has to meet its 450nS
+ * minimum width.
+ */
+
+void strobe (const struct lcdDataStruct *lcd)
+{
+  if (lcd->rwPin >= 0)
+  {
+    gpioWrite (lcd->strbPin, 1) ; delayMicroseconds (1) ;
+    gpioWrite (lcd->strbPin, 0) ; delayMicroseconds (1) ;
+    return ;
+  }
+  gpioWrite (lcd->strbPin, 1) ; delayMicroseconds (50) ;
+  gpioWrite (lcd->strbPin, 0) ; delayMicroseconds (50) ;
+}
+
+static void lcdBusMode (const struct lcdDataStruct *lcd, int mode)
+{
+  int i ;
+
+  for (i = 0 ; i < 4 ; ++i)
+    gpioMode (lcd->dataPins [i], mode) ;
+}
+
+/*
+ * Polls the busy flag on D7 until the controller is ready for the next
+ * instruction. Both nibbles have to be clocked out of a 4-bit read; the
+ * flag is in the first. RS is left as it was, so a caller sending a run
+ * of data bytes needn't raise it again for each one. Returns 0, or -1 if
+ * it was still busy after LCD_BUSY_TIMEOUT uS, which is longer than any
+ * instruction takes.
+ */
+int lcdBusyWait (const struct lcdDataStruct *lcd)
+{
+  int busy, rs, polls = 0 ;
+
+  if (lcd->rwPin < 0)
+    return 0 ;
+
+  rs = gpioRead (lcd->rsPin) != 0 ;
+  lcdBusMode (lcd, INPUT) ;
+  gpioWrite (lcd->rsPin, 0) ;
+  gpioWrite (lcd->rwPin, 1) ;
+  delayMicroseconds (1) ;		// R/W has to settle before E rises
+
+  do
+  {
+    gpioWrite (lcd->strbPin, 1) ; delayMicroseconds (1) ;
+    busy = gpioRead (lcd->dataPins [3]) != 0 ;
+    gpioWrite (lcd->strbPin, 0) ; delayMicroseconds (1) ;
+    gpioWrite (lcd->strbPin, 1) ; delayMicroseconds (1) ;
+    gpioWrite (lcd->strbPin, 0) ; delayMicroseconds (1) ;
+  }
+  while (busy && ++polls < LCD_BUSY_TIMEOUT / 4) ;
+
+  gpioWrite (lcd->rwPin, 0) ;
+  lcdBusMode (lcd, OUTPUT) ;
+  gpioWrite (lcd->rsPin, rs) ;
+
+  return busy ? -1 : 0 ;
+}
+
+/*
+ * Switches the driver from fixed delays to busy-flag polling, with the
+ * display's R/W line on @rwPin. Only use it when D7 is safe to read: an
+ * LCD run from 5V drives it at 5V, too much for a Pi input. Pass -1 to go
+ * back to fixed delays. Returns -1 for a pin outside bank 0.
+ */
+int lcdUseBusyFlag (struct lcdDataStruct *lcd, int rwPin)
+{
+  if (rwPin == -1)
+  {
+    lcd->rwPin = -1 ;
+    return 0 ;
+  }
+  if (rwPin & ~31)
+    return -1 ;
+
+  gpioWrite (rwPin, 0) ; gpioMode (rwPin, OUTPUT) ;
+  lcd->rwPin = rwPin ;
+  return 0 ;
+}
+
+/*
+ * Puts a nibble on the data pins: one store to raise the pins that are
+ * set and one to lower the rest.
+ */
+static inline void lcdNibbleOut (const struct lcdDataStruct *lcd, unsigned char nibble)
+{
+  const struct lcdNibble *n = &lcd->nibbles [nibble & 0x0F] ;
+
+  gpioWriteMask (n->set, n->clr) ;
+}
+
+void sendDataCmd (const struct lcdDataStruct *lcd, unsigned char data)
+{
+  lcdNibbleOut (lcd, data >> 4) ;
+  strobe (lcd) ;
+  lcdNibbleOut (lcd, data) ;
+  strobe (lcd) ;
+  lcdBusyWait (lcd) ;
+}
+
+void lcdPutCommand (const struct lcdDataStruct *lcd, unsigned char command)
+{
+  gpioWrite (lcd->rsPin,   0) ;
+  sendDataCmd  (lcd, command) ;
+  if (lcd->rwPin < 0)
+    delay (2) ;
+}
+
+void lcdPut4Command (const struct lcdDataStruct *lcd, unsigned char command)
+{
+  gpioWrite (lcd->rsPin,   0) ;
+  lcdNibbleOut (lcd, command) ;
+  strobe (lcd) ;
+}
+
+void lcdHome (struct lcdDataStruct *lcd)
+{
+  lcdPutCommand (lcd, LCD_HOME) ;
+  lcd->cx = lcd->cy = 0 ;
+  if (lcd->rwPin < 0)
+    delay (5) ;
+}
+
+void lcdClear (struct lcdDataStruct *lcd)
+{
+
+  lcdPutCommand (lcd, LCD_CLEAR) ;
+  lcdPutCommand (lcd, LCD_HOME) ;
+  lcd->cx = lcd->cy = 0 ;
+  memset (lcd->shown, ' ', sizeof (lcd->shown)) ;
+  if (lcd->rwPin < 0)
+    delay (5);
+
+}
+
+void lcdPosition (struct lcdDataStruct *lcd, int x, int y)
+{
+  if ((x > lcd->cols) || (x < 0))
+    return ;
+  if ((y > lcd->rows) || (y < 0))
+    return ;
+
+  lcdPutCommand (lcd, x + (LCD_DGRAM | (y>0 ? 0x40 : 0x00))) ;
+
+  lcd->cx = x ;
+  lcd->cy = y ;
+}
+
+void lcdDisplay (struct lcdDataStruct *lcd, int state)
+{
+  if (state)
+    lcdControl |=  LCD_DISPLAY_CTRL ;
+  else
+    lcdControl &= ~LCD_DISPLAY_CTRL ;
+
+  lcdPutCommand (lcd, LCD_CTRL | lcdControl) ;
+}
+
+void lcdCursor (struct lcdDataStruct *lcd, int state)
+{
+  if (state)
+    lcdControl |=  LCD_CURSOR_CTRL ;
+  else
+    lcdControl &= ~LCD_CURSOR_CTRL ;
+
+  lcdPutCommand (lcd, LCD_CTRL | lcdControl) ;
+}
+
+void lcdCursorBlink (struct lcdDataStruct *lcd, int state)
+{
+  if (state)
+    lcdControl |=  LCD_BLINK_CTRL ;
+  else
+    lcdControl &= ~LCD_BLINK_CTRL ;
+
+  lcdPutCommand (lcd, LCD_CTRL | lcdControl) ;
+}
+
+void lcdPutchar (struct lcdDataStruct *lcd, unsigned char data)
+{
+  gpioWrite (lcd->rsPin, 1) ;
+  sendDataCmd  (lcd, data) ;
+  if (lcd->cx < lcd->cols)
+    lcd->shown [lcd->cy][lcd->cx] = data ;
+
+  if (++lcd->cx == lcd->cols)
+  {
+    lcd->cx = 0 ;
+    if (++lcd->cy == lcd->rows)
+      lcd->cy = 0 ;
+
+    lcdPutCommand (lcd, lcd->cx + (LCD_DGRAM | (lcd->cy>0 ? 0x40 : 0x00))) ;
+  }
+}
+
+void lcdPuts (struct lcdDataStruct *lcd, const char *string)
+{
+  while (*string)
+    lcdPutchar (lcd, *string++) ;
+}
+
+/*
+ * Loads the 5x8 bitmap @data, one row per byte, into CGRAM slot @index;
+ * character code @index (or @index + 8) then shows it. Leaves the cursor
+ * where it was.
+ */
+void lcdCharDef (struct lcdDataStruct *lcd, int index, const unsigned char data [8])
+{
+  int i ;
+
+  lcdPutCommand (lcd, LCD_CGRAM | ((index & 7) << 3)) ;
+  gpioWrite (lcd->rsPin, 1) ;
+  for (i = 0 ; i < 8 ; ++i)
+    sendDataCmd (lcd, data [i]) ;
+  lcdPosition (lcd, lcd->cx, lcd->cy) ;
+}
+
+/*
+ * Defines logical glyph @id, to be drawn as LCD_GLYPH(@id). Nothing is
+ * sent until a flush needs it. Returns -1 for an id out of range.
+ */
+int lcdGlyphDefine (struct lcdDataStruct *lcd, int id, const unsigned char bitmap [8], char fallback)
+{
+  struct lcdGlyph *g ;
+
+  if ((id < 0) || (id >= LCD_GLYPHS))
+    return -1 ;
+
+  g = &lcd->glyphs [id] ;
+  if (g->slot >= 0)
+  {
+    lcd->slotGlyph [g->slot] = -1 ;	// stale bitmap; reload it when next used
+    g->slot = -1 ;
+  }
+  memcpy (g->bitmap, bitmap, sizeof (g->bitmap)) ;
+  g->fallback = fallback ;
+  g->defined  = 1 ;
+  return 0 ;
+}
+
+static int lcdGlyphId (char c)
+{
+  int id = (unsigned char)c - 0x80 ;
+
+  return (id >= 0) && (id < LCD_GLYPHS) ? id : -1 ;
+}
+
+// Marks the defined glyphs among the @len cells at @cells
+static void lcdGlyphNeed (const struct lcdDataStruct *lcd, int needed [LCD_GLYPHS], const char *cells, int len)
+{
+  int x, id ;
+
+  for (x = 0 ; x < len ; ++x)
+    if (((id = lcdGlyphId (cells [x])) >= 0) && lcd->glyphs [id].defined)
+      needed [id] = 1 ;
+}
+
+/*
+ * Gives every glyph in @needed a CGRAM slot before any cell is sent. Only
+ * slots no needed glyph is in are evicted, so a glyph that stays on the
+ * display never changes under it.
+ */
+static void lcdGlyphResolve (struct lcdDataStruct *lcd, const int needed [LCD_GLYPHS])
+{
+  int id, slot, i ;
+
+  for (id = 0 ; id < LCD_GLYPHS ; ++id)
+  {
+    struct lcdGlyph *g = &lcd->glyphs [id] ;
+
+    if (!needed [id])
+      continue ;
+    g->lastUsed = ++lcd->glyphClock ;
+    if (g->slot >= 0)
+    {
+      lcd->glyphHits++ ;
+      continue ;
+    }
+
+    slot = -1 ;
+    for (i = 0 ; i < LCD_GLYPH_SLOTS ; ++i)
+    {
+      int in = lcd->slotGlyph [i] ;
+
+      if (in < 0)
+      {
+        slot = i ;
+        break ;
+      }
+      if (needed [in] && (lcd->glyphs [in].slot == i))
+        continue ;
+      if ((slot < 0) || (lcd->glyphs [in].lastUsed < lcd->glyphs [lcd->slotGlyph [slot]].lastUsed))
+        slot = i ;
+    }
+    if (slot < 0)
+      continue ;			// all 8 are on the frame: this one falls back
+
+    if (lcd->slotGlyph [slot] >= 0)
+      lcd->glyphs [lcd->slotGlyph [slot]].slot = -1 ;
+    lcd->slotGlyph [slot] = id ;
+    g->slot = slot ;
+    lcdCharDef (lcd, slot, g->bitmap) ;
+    lcd->glyphUploads++ ;
+  }
+}
+
+// The code to send for frame cell @c: glyphs go as their CGRAM slot
+static unsigned char lcdCellCode (const struct lcdDataStruct *lcd, char c)
+{
+  int id = lcdGlyphId (c) ;
+  const struct lcdGlyph *g ;
+
+  if ((id < 0) || !lcd->glyphs [id].defined)
+    return c ;
+
+  g = &lcd->glyphs [id] ;
+  return g->slot >= 0 ? 8 + g->slot : g->fallback ;
+}
+
+/*
+ * Framebuffer. Callers draw into lcd->frame, which costs nothing, and
+ * lcdFlush() compares it with lcd->shown and sends only the cells that
+ * differ. That replaces lcdClear() and a full redraw, with its 7mS of
+ * command delays and the flicker, on every update. lcd->shown holds the
+ * codes sent, not glyph ids, so a glyph that moves to another slot, or
+ * gets one after falling back, is redrawn.
+ */
+
+void lcdFbClear (struct lcdDataStruct *lcd)
+{
+  memset (lcd->frame, ' ', sizeof (lcd->frame)) ;
+}
+
+/*
+ * Draws @string at column @x of row @y, clipped at the end of the row.
+ */
+void lcdFbPuts (struct lcdDataStruct *lcd, int x, int y, const char *string)
+{
+  if ((y >= lcd->rows) || (y < 0) || (x < 0))
+    return ;
+
+  while (*string && x < lcd->cols)
+    lcd->frame [y][x++] = *string++ ;
+}
+
+/*
+ * Replaces row @y with @string, padded with blanks.
+ */
+void lcdFbLine (struct lcdDataStruct *lcd, int y, const char *string)
+{
+  if ((y >= lcd->rows) || (y < 0))
+    return ;
+
+  memset (lcd->frame [y], ' ', lcd->cols) ;
+  lcdFbPuts (lcd, 0, y, string) ;
+}
+
+/*
+ * Writes one character at the cursor without lcdPutchar()'s wrap, which
+ * would cost a position command; the next dirty cell sets its own.
+ */
+static void lcdFlushChar (struct lcdDataStruct *lcd, int x, int y)
+{
+  unsigned char code = lcdCellCode (lcd, lcd->frame [y][x]) ;
+
+  gpioWrite (lcd->rsPin, 1) ;
+  sendDataCmd  (lcd, code) ;
+  lcd->shown [y][x] = code ;
+  lcd->cx = x + 1 ;
+}
+
+/*
+ * Sends the cells of lcd->frame that differ from the display. A run of
+ * dirty cells costs one DDRAM address, and a clean gap of up to
+ * LCD_FLUSH_GAP cells is rewritten rather than addressed around, as a
+ * command (2mS) costs far more than a character. Returns the number of
+ * characters sent.
+ */
+int lcdFlush (struct lcdDataStruct *lcd)
+{
+  int needed [LCD_GLYPHS] = { 0 } ;
+  int x, y, sent = 0 ;
+
+  lcdMarqueeStop (lcd) ;
+  for (y = 0 ; y < lcd->rows ; ++y)
+    lcdGlyphNeed (lcd, needed, lcd->frame [y], lcd->cols) ;
+  lcdGlyphResolve (lcd, needed) ;
+
+  for (y = 0 ; y < lcd->rows ; ++y)
+    for (x = 0 ; x < lcd->cols ; ++x)
+    {
+      if ((char)lcdCellCode (lcd, lcd->frame [y][x]) == lcd->shown [y][x])
+        continue ;
+
+      if ((lcd->cy == y) && (lcd->cx <= x) && (x - lcd->cx <= LCD_FLUSH_GAP))
+        while (lcd->cx < x)
+        {
+          lcdFlushChar (lcd, lcd->cx, y) ;
+          ++sent ;
+        }
+      else
+        lcdPosition (lcd, x, y) ;
+
+      lcdFlushChar (lcd, x, y) ;
+      ++sent ;
+    }
+
+  return sent ;
+}
+
+/*
+ * Shows @top and @bottom on the two rows, replacing what was there, and
+ * sends only the characters that changed.
+ */
+int lcdWriteLines (struct lcdDataStruct *lcd, const char *top, const char *bottom)
+{
+  lcdFbLine (lcd, 0, top) ;
+  lcdFbLine (lcd, 1, bottom) ;
+  return lcdFlush (lcd) ;
+}
+
+/*
+ * Row formatting into a struct lcdLine.
+ */
+
+void lcdLineClear (struct lcdLine *line)
+{
+  line->len      = 0 ;
+  line->text [0] = '\0' ;
+}
+
+void lcdLineChar (struct lcdLine *line, char c)
+{
+  if (line->len == LCD_LINE_LEN)
+    return ;
+
+  line->text [line->len++] = c ;
+  line->text [line->len]   = '\0' ;
+}
+
+void lcdLineStr (struct lcdLine *line, const char *string)
+{
+  while (*string)
+    lcdLineChar (line, *string++) ;
+}
+
+/*
+ * Appends @value in decimal, however many digits it has.
+ */
+void lcdLineInt (struct lcdLine *line, int value)
+{
+  char digits [12] ;
+  unsigned int v = value < 0 ? -(unsigned int)value : (unsigned int)value ;
+  int n = 0 ;
+
+  do
+  {
+    digits [n++] = '0' + v % 10 ;
+    v /= 10 ;
+  }
+  while (v != 0) ;
+
+  if (value < 0)
+    lcdLineChar (line, '-') ;
+  while (n > 0)
+    lcdLineChar (line, digits [--n]) ;
+}
+
+/*
+ * Marquee. Each row of DDRAM is LCD_LINE_LEN cells long, of which the
+ * display shows the first cols. Instead of redrawing the visible window
+ * for every frame, a marquee writes whole rows once and then moves the
+ * window with a display shift command: one bus write per frame instead of
+ * one per visible cell and a position. The controller shifts both rows
+ * together, and the window wraps round from the end of a row to its start.
+ */
+
+static void lcdMarqueeRow (struct lcdDataStruct *lcd, int y, const char *string)
+{
+  unsigned char code ;
+  int x ;
+
+  lcdPosition (lcd, 0, y) ;
+  gpioWrite (lcd->rsPin, 1) ;
+  for (x = 0 ; x < LCD_LINE_LEN ; ++x)
+  {
+    code = lcdCellCode (lcd, *string ? *string : ' ') ;
+    sendDataCmd (lcd, code) ;
+    if (x < lcd->cols)
+      lcd->shown [y][x] = code ;
+    if (*string)
+      ++string ;
+  }
+}
+
+/*
+ * Writes @top and @bottom, up to LCD_LINE_LEN characters each, into
+ * DDRAM with the window at their start. Returns the length of the longer
+ * one; moving the window that many cells less the width of the display
+ * brings the end of both into view.
+ */
+int lcdMarqueeStart (struct lcdDataStruct *lcd, const char *top, const char *bottom)
+{
+  const char *lines [LCD_MAX_ROWS] = { top, bottom } ;
+  int needed [LCD_GLYPHS] = { 0 } ;
+  int y, len, longest = 0 ;
+
+  // The glyphs of both rows go into CGRAM first, off screen cells and all
+  for (y = 0 ; y < lcd->rows ; ++y)
+  {
+    if (lines [y] == NULL)
+      lines [y] = "" ;
+    len = strnlen (lines [y], LCD_LINE_LEN) ;
+    if (len > longest)
+      longest = len ;
+    lcdGlyphNeed (lcd, needed, lines [y], len) ;
+  }
+  lcdGlyphResolve (lcd, needed) ;
+
+  lcdHome (lcd) ;			// also takes the window back to the start
+  for (y = 0 ; y < lcd->rows ; ++y)
+    lcdMarqueeRow (lcd, y, lines [y]) ;
+  lcdPosition (lcd, 0, 0) ;
+
+  lcd->marqueeOn    = 1 ;
+  lcd->marqueeShift = 0 ;
+  return longest ;
+}
+
+/*
+ * Moves the window one cell to the right, so the text moves left.
+ */
+void lcdMarqueeStep (struct lcdDataStruct *lcd)
+{
+  if (!lcd->marqueeOn)
+    return ;
+
+  lcdPutCommand (lcd, LCD_CDSHIFT | LCD_CDSHIFT_SC) ;
+  lcd->marqueeShift = (lcd->marqueeShift + 1) % LCD_LINE_LEN ;
+}
+
+/*
+ * Takes the window back to the start of the rows, where lcd->shown
+ * describes them, so the framebuffer can carry on from there.
+ */
+void lcdMarqueeStop (struct lcdDataStruct *lcd)
+{
+  if (!lcd->marqueeOn)
+    return ;
+
+  lcdHome (lcd) ;
+  lcd->marqueeOn = 0 ;
+}
+
+/*
+ * Sets up the pins and runs the HD44780 power-on sequence. Only a 4-bit
+ * bus is supported; returns NULL for anything else, a pin outside bank 0
+ * or no memory. The GPIO backend has to be open already.
+ *
+ * Bit i of a nibble goes to dataPins [i], so nibbles [n] holds the pins to
+ * raise and lower for nibble n.
+ */
+struct lcdDataStruct *lcdInit (int rows, int cols, int bits, int rs, int strb,
+                               int d0, int d1, int d2, int d3)
+{
+  struct lcdDataStruct *lcd ;
+  unsigned char func ;
+  int i, n ;
+
+  if ((bits != 4) || (rows > LCD_MAX_ROWS) || (cols > LCD_MAX_COLS))
+    return NULL ;
+  if ((rs | strb | d0 | d1 | d2 | d3) & ~31)
+    return NULL ;
+
+  lcd = (struct lcdDataStruct *)calloc (1, sizeof (struct lcdDataStruct)) ;
+  if (lcd == NULL)
+    return NULL ;
+
+  lcd->rsPin   = rs ;
+  lcd->strbPin = strb ;
+  lcd->rwPin   = -1 ;    // fixed delays until lcdUseBusyFlag()
+  lcd->bits    = bits ;
+  lcd->rows    = rows ;  // # of rows on the display
+  lcd->cols    = cols ;  // # of cols on the display
+  lcd->cx      = 0 ;     // x-pos of cursor
+  lcd->cy      = 0 ;     // y-pos of curosr
+
+  lcd->dataPins [0] = d0 ;
+  lcd->dataPins [1] = d1 ;
+  lcd->dataPins [2] = d2 ;
+  lcd->dataPins [3] = d3 ;
+
+  for (i = 0 ; i < LCD_GLYPHS ; ++i)
+    lcd->glyphs [i].slot = -1 ;
+  for (i = 0 ; i < LCD_GLYPH_SLOTS ; ++i)
+    lcd->slotGlyph [i] = -1 ;
+
+  for (n = 0 ; n < 16 ; ++n)
+    for (i = 0 ; i < 4 ; ++i)
+      if (n & (1 << i))
+        lcd->nibbles [n].set |= GPIO_BIT (lcd->dataPins [i]) ;
+      else
+        lcd->nibbles [n].clr |= GPIO_BIT (lcd->dataPins [i]) ;
+
+  gpioWrite (lcd->rsPin,   0) ; gpioMode (lcd->rsPin,   OUTPUT) ;
+  gpioWrite (lcd->strbPin, 0) ; gpioMode (lcd->strbPin, OUTPUT) ;
+
+  for (i = 0 ; i < bits ; ++i)
+  {
+    gpioWrite (lcd->dataPins [i], 0) ;
+    gpioMode  (lcd->dataPins [i], OUTPUT) ;
+  }
+  delay (35) ; // mS
+
+  func = LCD_FUNC | LCD_FUNC_DL ;			// Set 8-bit mode 3 times
+  lcdPut4Command (lcd, func >> 4) ; delay (35) ;
+  lcdPut4Command (lcd, func >> 4) ; delay (35) ;
+  lcdPut4Command (lcd, func >> 4) ; delay (35) ;
+  func = LCD_FUNC ;					// 4th set: 4-bit mode
+  lcdPut4Command (lcd, func >> 4) ; delay (35) ;
+
+  if (lcd->rows > 1)
+  {
+    func |= LCD_FUNC_N ;
+    lcdPutCommand (lcd, func) ; delay (35) ;
+  }
+
+  // Rest of the initialisation sequence
+  lcdDisplay     (lcd, 1) ;
+  lcdCursor      (lcd, 0) ;
+  lcdCursorBlink (lcd, 0) ;
+  lcdPutCommand (lcd, LCD_ENTRY   | LCD_ENTRY_ID) ;    // set entry mode to increment address counter after write
+  lcdPutCommand (lcd, LCD_CDSHIFT | LCD_CDSHIFT_RL) ;  // set display shift to right-to-left
+  lcdClear       (lcd) ;                               // last: the shift above moves the cursor off home
+  lcdFbClear (lcd) ;
+
+  return lcd ;
+}
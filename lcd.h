@@ -0,0 +1,144 @@
+#ifndef LCD_H
+#define LCD_H
+
+#include <stdint.h>
+
+/*
+ * Driver for an HD44780 character display on a 4-bit bus, after the
+ * wiringPi lcd library. All pins must be in GPIO bank 0 (below 32), so a
+ * whole nibble goes onto the bus with one GPSET0 and one GPCLR0 store.
+ */
+
+#define	LCD_FUNC_F	0x04
+#define	LCD_FUNC_N	0x08
+#define	LCD_FUNC_DL	0x10
+
+#define	LCD_CDSHIFT_RL	0x04
+#define	LCD_CDSHIFT_SC	0x08
+#define	LCD_BLINK_CTRL		0x01
+#define	LCD_CURSOR_CTRL		0x02
+#define	LCD_DISPLAY_CTRL	0x04
+
+#define	LCD_CLEAR	0x01
+#define	LCD_HOME	0x02
+#define	LCD_ENTRY	0x04
+#define	LCD_CTRL	0x08
+#define	LCD_CDSHIFT	0x10
+#define	LCD_FUNC	0x20
+#define	LCD_CGRAM	0x40
+#define	LCD_DGRAM	0x80
+
+// Bits in the entry register
+
+#define	LCD_ENTRY_SH		0x01
+#define	LCD_ENTRY_ID		0x02
+
+// Largest display lcdInit() accepts, and the size of the framebuffer
+#define	LCD_MAX_ROWS	2
+#define	LCD_MAX_COLS	16
+
+// DDRAM cells in each row of a two-line display, visible or not
+#define	LCD_LINE_LEN	40
+
+// Clean cells lcdFlush() rewrites rather than move the cursor past them
+#define	LCD_FLUSH_GAP	8
+
+// Longest lcdBusyWait() polls before giving up, uS
+#define	LCD_BUSY_TIMEOUT	5000
+
+/*
+ * Custom glyphs. The display has 8 CGRAM slots; logical glyphs (up to
+ * LCD_GLYPHS) are defined once with lcdGlyphDefine() and drawn into the
+ * framebuffer as LCD_GLYPH(id), which takes the place of ROM codes
+ * 0x80-0x9F. lcdFlush() gives each glyph on the frame a slot, uploading
+ * its bitmap only if it isn't already resident, and evicts the least
+ * recently used slot not on the frame when it needs room.
+ */
+#define	LCD_GLYPHS	32
+#define	LCD_GLYPH_SLOTS	8
+#define	LCD_GLYPH(id)	((char)(0x80 + (id)))
+
+struct lcdGlyph
+{
+  unsigned char bitmap [8] ;
+  char fallback ;			// shown if more than 8 glyphs are on the frame
+  int defined ;
+  int slot ;				// -1 if not in CGRAM
+  unsigned int lastUsed ;
+} ;
+
+/*
+ * A row of text built up in place, for lcdRenderSubmit() or the
+ * framebuffer, with no heap and no sprintf buffers. Anything past
+ * LCD_LINE_LEN is cut off, and the text is always terminated.
+ */
+struct lcdLine
+{
+  char text [LCD_LINE_LEN + 1] ;
+  int  len ;
+} ;
+
+// GPSET0/GPCLR0 masks that put one nibble on the data pins
+struct lcdNibble
+{
+  uint32_t set, clr ;
+} ;
+
+struct lcdDataStruct
+{
+  int bits, rows, cols ;
+  int rsPin, strbPin ;
+  int rwPin ;				// -1 if R/W is tied low, see lcdUseBusyFlag()
+  int dataPins [8] ;
+  int cx, cy ;
+  struct lcdNibble nibbles [16] ;	// indexed by nibble value, see lcdInit()
+  char frame [LCD_MAX_ROWS][LCD_MAX_COLS] ;	// what the caller wants shown
+  char shown [LCD_MAX_ROWS][LCD_MAX_COLS] ;	// the codes the display holds
+  struct lcdGlyph glyphs [LCD_GLYPHS] ;
+  int slotGlyph [LCD_GLYPH_SLOTS] ;	// glyph in each CGRAM slot, -1 if none
+  unsigned int glyphClock ;
+  unsigned long glyphUploads, glyphHits ;
+  int marqueeOn ;			// display shifted by a marquee, see lcdMarqueeStart()
+  int marqueeShift ;
+};
+
+struct lcdDataStruct *lcdInit (int rows, int cols, int bits, int rs, int strb,
+                               int d0, int d1, int d2, int d3) ;
+
+int  lcdUseBusyFlag (struct lcdDataStruct *lcd, int rwPin) ;
+int  lcdBusyWait    (const struct lcdDataStruct *lcd) ;
+
+void strobe         (const struct lcdDataStruct *lcd) ;
+void sendDataCmd    (const struct lcdDataStruct *lcd, unsigned char data) ;
+void lcdPutCommand  (const struct lcdDataStruct *lcd, unsigned char command) ;
+void lcdPut4Command (const struct lcdDataStruct *lcd, unsigned char command) ;
+
+void lcdHome        (struct lcdDataStruct *lcd) ;
+void lcdClear       (struct lcdDataStruct *lcd) ;
+void lcdPosition    (struct lcdDataStruct *lcd, int x, int y) ;
+void lcdDisplay     (struct lcdDataStruct *lcd, int state) ;
+void lcdCursor      (struct lcdDataStruct *lcd, int state) ;
+void lcdCursorBlink (struct lcdDataStruct *lcd, int state) ;
+void lcdPutchar     (struct lcdDataStruct *lcd, unsigned char data) ;
+void lcdPuts        (struct lcdDataStruct *lcd, const char *string) ;
+void lcdCharDef     (struct lcdDataStruct *lcd, int index, const unsigned char data [8]) ;
+int  lcdGlyphDefine (struct lcdDataStruct *lcd, int id, const unsigned char bitmap [8], char fallback) ;
+
+// Framebuffer: draw into frame, then lcdFlush() sends only what changed
+void lcdFbClear     (struct lcdDataStruct *lcd) ;
+void lcdFbPuts      (struct lcdDataStruct *lcd, int x, int y, const char *string) ;
+void lcdFbLine      (struct lcdDataStruct *lcd, int y, const char *string) ;
+int  lcdFlush       (struct lcdDataStruct *lcd) ;
+int  lcdWriteLines  (struct lcdDataStruct *lcd, const char *top, const char *bottom) ;
+
+void lcdLineClear   (struct lcdLine *line) ;
+void lcdLineChar    (struct lcdLine *line, char c) ;
+void lcdLineStr     (struct lcdLine *line, const char *string) ;
+void lcdLineInt     (struct lcdLine *line, int value) ;
+
+// Marquee: rows longer than the display, scrolled by the controller
+int  lcdMarqueeStart (struct lcdDataStruct *lcd, const char *top, const char *bottom) ;
+void lcdMarqueeStep  (struct lcdDataStruct *lcd) ;
+void lcdMarqueeStop  (struct lcdDataStruct *lcd) ;
+
+#endif
@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gpio.h"
+#include "timing.h"
+#include "lcd.h"
+#include "render.h"
+#include "lcdsim.h"
+
+/*
+ * Times the LCD driver with the pins cw.c uses. Every workload runs once
+ * with the fixed datasheet delays and once polling the busy flag:
+ *
+ *   redraw   the old way to show a screen, lcdClear() and both lines
+ *   flush    the framebuffer, sending only the cells that changed
+ *   char     lcdPutchar() along a row, also as chars_per_s
+ *   render   lcdRenderSubmit() until the screen is on the display
+ *   glyph    frames with more custom glyphs than CGRAM has slots, one
+ *            of them redefined while on show, then a marquee with glyphs
+ *
+ * and nibble_* compares the batched mask write the driver uses with
+ * setting the four data pins one by one.
+ * Output is one "key: value" per line, with n/a for anything that can't
+ * be measured here, so runs can be diffed to catch regressions.
+ *
+ *   ./lcdbench [-f] [rwPin]
+ *
+ * Busy-flag results need the display's R/W line on @rwPin; without it
+ * they are reported as n/a, except on the sim backend, where an unused
+ * pin stands in. On the sim backend the simulated HD44780 (lcdsim.c) is
+ * attached as well: each mode reports whether the display ended up
+ * showing what the driver thinks it does, and any timing violations.
+ * -f runs on the fake clock, where every time is just the sum of the
+ * driver's waits, the same on every run.
+ */
+
+#define STRB_PIN 24
+#define RS_PIN   25
+#define DATA0_PIN 23
+#define DATA1_PIN 10
+#define DATA2_PIN 27
+#define DATA3_PIN 22
+
+// Pin the sim backend uses for R/W when none is given
+#define SIM_RW_PIN 18
+
+#define NIBBLES 100000
+
+// One more than the CGRAM slots, so one has to fall back
+#define GLYPHS 9
+
+static const char *tops[] = { "1 2 3 4", "1 2 3 5", "1 4 3 5", "Success" };
+static const char *bottoms[] = { "Exact:1 Near:2", "Exact:2 Near:1", "Exact:3 Near:0", "4" };
+
+#define SCREENS (sizeof(tops) / sizeof(tops[0]))
+
+static struct lcdSim sim;
+static int simAttached;
+
+static double ms(uint64_t start) {
+  return (timeNowNs() - start) / 1e6;
+}
+
+static double timeRedraw(struct lcdDataStruct *lcd) {
+
+  uint64_t start = timeNowNs();
+  unsigned i;
+
+  for(i = 0; i < SCREENS; i++) {
+    lcdClear(lcd);
+    lcdPosition (lcd, 0, 0) ; lcdPuts (lcd, tops[i]) ;
+    lcdPosition (lcd, 0, 1) ; lcdPuts (lcd, bottoms[i]) ;
+  }
+  return ms(start) / SCREENS;
+}
+
+static double timeFlush(struct lcdDataStruct *lcd) {
+
+  uint64_t start = timeNowNs();
+  unsigned i;
+
+  for(i = 0; i < SCREENS; i++) {
+    lcdFbLine(lcd, 0, tops[i]);
+    lcdFbLine(lcd, 1, bottoms[i]);
+    lcdFlush(lcd);
+  }
+  return ms(start) / SCREENS;
+}
+
+static double timeChars(struct lcdDataStruct *lcd) {
+
+  uint64_t start = timeNowNs();
+  int i;
+
+  lcdPosition(lcd, 0, 0);
+  for(i = 0; i < 16; i++) {
+    lcdPutchar(lcd, 'A' + i);
+  }
+  return ms(start) * 1e3 / 16;
+}
+
+/*
+ * From submitting a screen to the render thread until it is drawn.
+ */
+static double timeRender(struct lcdDataStruct *lcd) {
+
+  struct lcdRender render;
+  uint64_t start;
+  unsigned i;
+
+  if(lcdRenderStart(&render, lcd) != 0) {
+    return -1;
+  }
+  start = timeNowNs();
+  for(i = 0; i < SCREENS; i++) {
+    lcdRenderSubmit(&render, tops[i], bottoms[i]);
+    lcdRenderWait(&render);
+  }
+  lcdRenderStop(&render);
+  return ms(start) / SCREENS;
+}
+
+// Whether the simulated display shows what the driver thinks it does
+static int simMatches(const struct lcdDataStruct *lcd) {
+
+  char row[LCD_MAX_COLS];
+  int y;
+
+  for(y = 0; y < lcd->rows; y++) {
+    lcdSimRow(&sim, y, row, lcd->cols);
+    if(memcmp(row, lcd->shown[y], lcd->cols) != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+ * Whether the simulated display shows @want with @code: a glyph with a
+ * slot as a CGRAM code holding its bitmap, one without as its fallback,
+ * and anything else as itself.
+ */
+static int simShowsCell(const struct lcdDataStruct *lcd, unsigned char code, char want) {
+
+  int id = (unsigned char)want - 0x80;
+  const struct lcdGlyph *g;
+  int i;
+
+  if(id < 0 || id >= LCD_GLYPHS || !lcd->glyphs[id].defined) {
+    return code == (unsigned char)want;
+  }
+  g = &lcd->glyphs[id];
+  if(g->slot < 0) {
+    return code == (unsigned char)g->fallback;
+  }
+  if(code >= 16 || (code & 7) != g->slot) {
+    return 0;
+  }
+  for(i = 0; i < 8; i++) {
+    if((sim.cgramData[g->slot * 8 + i] & 0x1F) != (g->bitmap[i] & 0x1F)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Whether row @y of the simulated display shows the first @len of @cells
+static int simShowsRow(const struct lcdDataStruct *lcd, int y, const char *cells, int len) {
+
+  char row[LCD_LINE_LEN];
+  int x;
+
+  lcdSimRow(&sim, y, row, len);
+  for(x = 0; x < len; x++) {
+    if(!simShowsCell(lcd, row[x], cells[x])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int simShowsFrame(const struct lcdDataStruct *lcd) {
+
+  int y, ok = 1;
+
+  for(y = 0; y < lcd->rows; y++) {
+    ok &= simShowsRow(lcd, y, lcd->frame[y], lcd->cols);
+  }
+  return ok;
+}
+
+/*
+ * Nine glyphs at once, so the last falls back; then that one alone, so
+ * it gets a slot where its fallback was shown; then it is redefined while
+ * on show; then two more go past the edge of a marquee row. The sim
+ * checks each screen cell by cell.
+ */
+static void reportGlyphs(struct lcdDataStruct *lcd, const char *mode) {
+
+  unsigned char bitmap[8];
+  struct lcdLine top;
+  unsigned long uploads = lcd->glyphUploads;
+  uint64_t start;
+  int ok = 1, i;
+
+  for(i = 0; i < GLYPHS; i++) {
+    memset(bitmap, i + 1, sizeof(bitmap));
+    lcdGlyphDefine(lcd, i, bitmap, 'A' + i);
+  }
+
+  start = timeNowNs();
+  lcdFbClear(lcd);
+  for(i = 0; i < GLYPHS; i++) {
+    lcd->frame[0][i] = LCD_GLYPH(i);
+  }
+  lcdFbPuts(lcd, 0, 1, "all nine");
+  lcdFlush(lcd);
+  ok &= simShowsFrame(lcd);
+
+  lcdFbClear(lcd);
+  lcd->frame[0][GLYPHS - 1] = LCD_GLYPH(GLYPHS - 1);
+  lcdFbPuts(lcd, 0, 1, "the last one");
+  lcdFlush(lcd);
+  ok &= simShowsFrame(lcd);
+
+  memset(bitmap, 0x1F, sizeof(bitmap));
+  lcdGlyphDefine(lcd, GLYPHS - 1, bitmap, '#');
+  lcdFlush(lcd);
+  ok &= simShowsFrame(lcd);
+
+  lcdLineClear(&top);
+  lcdLineStr(&top, "Guess 12: ");
+  lcdLineChar(&top, LCD_GLYPH(0));
+  lcdLineInt(&top, 3);
+  lcdLineChar(&top, ' ');
+  lcdLineChar(&top, LCD_GLYPH(1));
+  lcdLineInt(&top, 4);
+  lcdMarqueeStart(lcd, top.text, "1 2 3 4 5 6 7 8 9 1 2 3");
+  // Two glyphs fit in CGRAM, so neither may fall back
+  ok &= lcd->glyphs[0].slot >= 0 && lcd->glyphs[1].slot >= 0;
+  ok &= simShowsRow(lcd, 0, top.text, top.len);
+  lcdMarqueeStop(lcd);
+
+  printf("%s_glyph_flush_ms: %.3f\n", mode, ms(start) / 4);
+  printf("%s_glyph_uploads: %lu\n", mode, lcd->glyphUploads - uploads);
+  if(simAttached) {
+    printf("%s_glyph_sim_ok: %d\n", mode, ok);
+  } else {
+    printf("%s_glyph_sim_ok: n/a\n", mode);
+  }
+}
+
+static void report(struct lcdDataStruct *lcd, const char *mode) {
+
+  unsigned long violations = simAttached ? lcdSimViolationCount(&sim) : 0;
+  int ok = 1;
+  double charUs, renderMs;
+
+  printf("%s_redraw_ms: %.3f\n", mode, timeRedraw(lcd));
+  ok &= !simAttached || simMatches(lcd);
+  printf("%s_flush_ms: %.3f\n", mode, timeFlush(lcd));
+  ok &= !simAttached || simMatches(lcd);
+  charUs = timeChars(lcd);
+  printf("%s_char_us: %.1f\n", mode, charUs);
+  printf("%s_chars_per_s: %.0f\n", mode, charUs > 0 ? 1e6 / charUs : 0.0);
+  ok &= !simAttached || simMatches(lcd);
+
+  renderMs = timeRender(lcd);
+  if(renderMs < 0) {
+    printf("%s_render_ms: n/a\n", mode);
+  } else {
+    printf("%s_render_ms: %.3f\n", mode, renderMs);
+  }
+  ok &= !simAttached || simMatches(lcd);
+
+  reportGlyphs(lcd, mode);
+
+  if(simAttached) {
+    printf("%s_sim_ok: %d\n", mode, ok);
+    printf("%s_sim_violations: %lu\n", mode, lcdSimViolationCount(&sim) - violations);
+  } else {
+    printf("%s_sim_ok: n/a\n%s_sim_violations: n/a\n", mode, mode);
+  }
+}
+
+static void reportNa(const char *mode) {
+
+  static const char *keys[] = { "redraw_ms", "flush_ms", "char_us", "chars_per_s", "render_ms",
+                                "glyph_flush_ms", "glyph_uploads", "glyph_sim_ok", "sim_ok", "sim_violations" };
+  unsigned i;
+
+  for(i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+    printf("%s_%s: n/a\n", mode, keys[i]);
+  }
+}
+
+/*
+ * One nibble on the data pins, as the driver puts it (one GPSET0 and one
+ * GPCLR0 store) and as four single-pin writes.
+ */
+static void reportNibbles(struct lcdDataStruct *lcd) {
+
+  uint64_t start;
+  int i, bit;
+
+  if(timeIsFake()) {
+    printf("nibble_mask_ns: n/a\nnibble_pins_ns: n/a\n");
+    return;
+  }
+
+  start = timeNowNs();
+  for(i = 0; i < NIBBLES; i++) {
+    gpioWriteMask(lcd->nibbles[i & 15].set, lcd->nibbles[i & 15].clr);
+  }
+  printf("nibble_mask_ns: %.1f\n", ms(start) * 1e6 / NIBBLES);
+
+  start = timeNowNs();
+  for(i = 0; i < NIBBLES; i++) {
+    for(bit = 0; bit < 4; bit++) {
+      gpioWrite(lcd->dataPins[bit], (i >> bit) & 1);
+    }
+  }
+  printf("nibble_pins_ns: %.1f\n", ms(start) * 1e6 / NIBBLES);
+}
+
+int main(int argc, char **argv) {
+
+  struct lcdDataStruct *lcd;
+  struct delayStats stats;
+  int rwPin = -1, arg = 1;
+  uint64_t start;
+  double init;
+
+  if(arg < argc && strcmp(argv[arg], "-f") == 0) {
+    timeFake(1000000000ULL);
+    arg++;
+  }
+  if(gpioSetup(NULL) != 0) {
+    perror("gpioSetup");
+    return 1;
+  }
+  if(arg < argc) {
+    rwPin = atoi(argv[arg]);
+  } else if(gpioSimActive) {
+    rwPin = SIM_RW_PIN;
+  }
+  if(gpioSimActive) {
+    simAttached = lcdSimAttach(&sim, RS_PIN, rwPin, STRB_PIN, DATA0_PIN, DATA1_PIN, DATA2_PIN, DATA3_PIN) == 0;
+  }
+
+  start = timeNowNs();
+  lcd = lcdInit(2, 16, 4, RS_PIN, STRB_PIN, DATA0_PIN, DATA1_PIN, DATA2_PIN, DATA3_PIN);
+  init = ms(start);
+  if(lcd == NULL) {
+    fprintf(stderr, "can't initialise the LCD\n");
+    return 1;
+  }
+
+  printf("backend: %s\n", gpioBackendName());
+  printf("clock: %s\n", timeIsFake() ? "fake" : "real");
+  printf("sim_lcd: %s\n", simAttached ? "hd44780" : "none");
+  printf("init_ms: %.3f\n", init);
+  if(simAttached) {
+    printf("init_sim_ok: %d\n", simMatches(lcd));
+    printf("init_sim_violations: %lu\n", lcdSimViolationCount(&sim));
+  } else {
+    printf("init_sim_ok: n/a\ninit_sim_violations: n/a\n");
+  }
+  delayStatsReset();
+  report(lcd, "fixed");
+
+  if(rwPin >= 0 && lcdUseBusyFlag(lcd, rwPin) == 0) {
+    report(lcd, "busy");
+    lcdUseBusyFlag(lcd, -1);
+  } else {
+    reportNa("busy");
+  }
+
+  reportNibbles(lcd);
+
+  delayStatsGet(&stats);
+  printf("delay_calls: %llu\n", (unsigned long long)stats.calls);
+  printf("delay_mean_overshoot_ns: %.0f\n", stats.calls ? (double)stats.overshootNs / stats.calls : 0.0);
+  printf("delay_max_overshoot_ns: %llu\n", (unsigned long long)stats.maxOvershootNs);
+
+  if(simAttached) {
+    printf("sim_instructions: %lu\n", sim.instructions);
+    printf("sim_writes: %lu\n", sim.writes);
+    printf("sim_reads: %lu\n", sim.reads);
+    printf("sim_min_pulse_ns: %llu\n", (unsigned long long)sim.minPulseNs);
+    printf("sim_min_cycle_ns: %llu\n", (unsigned long long)sim.minCycleNs);
+    printf("sim_min_setup_ns: %llu\n", (unsigned long long)sim.minSetupNs);
+    lcdSimDetach(&sim);
+  }
+
+  free(lcd);
+  gpioClose();
+  return 0;
+}
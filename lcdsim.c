@@ -0,0 +1,312 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "gpio.h"
+#include "timing.h"
+#include "lcd.h"
+#include "lcdsim.h"
+
+static uint32_t lcdSimDataMask (const struct lcdSim *s)
+{
+  return s->data [0] | s->data [1] | s->data [2] | s->data [3] ;
+}
+
+static unsigned char lcdSimNibbleIn (const struct lcdSim *s, uint32_t levels)
+{
+  unsigned char n = 0 ;
+  int i ;
+
+  for (i = 0 ; i < 4 ; ++i)
+    if (levels & s->data [i])
+      n |= 1 << i ;
+  return n ;
+}
+
+static uint32_t lcdSimNibbleOut (const struct lcdSim *s, unsigned char n)
+{
+  uint32_t bits = 0 ;
+  int i ;
+
+  for (i = 0 ; i < 4 ; ++i)
+    if (n & (1 << i))
+      bits |= s->data [i] ;
+  return bits ;
+}
+
+// Moves the address counter on after a read or write, the way the chip wraps it
+static void lcdSimStep (struct lcdSim *s)
+{
+  if (s->cgram)
+  {
+    s->ac = (s->ac + (s->increment ? 1 : -1)) & (LCDSIM_CGRAM - 1) ;
+    return ;
+  }
+
+  if (!s->twoLines)
+    s->ac = (s->ac + (s->increment ? 1 : 79)) % 80 ;
+  else if (s->increment)
+    s->ac = s->ac == 0x27 ? 0x40 : s->ac == 0x67 ? 0x00 : s->ac + 1 ;
+  else
+    s->ac = s->ac == 0x00 ? 0x67 : s->ac == 0x40 ? 0x27 : s->ac - 1 ;
+}
+
+static void lcdSimClear (struct lcdSim *s)
+{
+  memset (s->ddram, ' ', sizeof (s->ddram)) ;
+  s->ac        = 0 ;
+  s->cgram     = 0 ;
+  s->shift     = 0 ;
+  s->increment = 1 ;
+}
+
+/*
+ * Runs one byte the controller has latched, and returns how long it stays
+ * busy with it.
+ */
+static uint64_t lcdSimExecute (struct lcdSim *s, int rs, unsigned char b)
+{
+  uint64_t exec = LCDSIM_EXEC_NS ;
+
+  if (rs)
+  {
+    s->writes++ ;
+    if (s->cgram)
+      s->cgramData [s->ac] = b ;
+    else
+    {
+      s->ddram [s->ac] = b ;
+      if (s->shiftOnWrite)
+        s->shift += s->increment ? -1 : 1 ;
+    }
+    lcdSimStep (s) ;
+    return exec ;
+  }
+
+  s->instructions++ ;
+  /**/ if (b & LCD_DGRAM)
+  {
+    s->ac    = b & 0x7F ;
+    s->cgram = 0 ;
+  }
+  else if (b & LCD_CGRAM)
+  {
+    s->ac    = b & 0x3F ;
+    s->cgram = 1 ;
+  }
+  else if (b & LCD_FUNC)
+  {
+    // The first two function sets from reset take longer, see the datasheet's init by instruction
+    if (s->eightBit && ++s->inits <= 2)
+      exec = s->inits == 1 ? LCDSIM_INIT1_NS : LCDSIM_INIT2_NS ;
+    s->eightBit  = (b & LCD_FUNC_DL) != 0 ;
+    s->twoLines  = (b & LCD_FUNC_N) != 0 ;
+    s->lowNibble = 0 ;
+  }
+  else if (b & LCD_CDSHIFT)
+  {
+    if (b & LCD_CDSHIFT_SC)
+      s->shift += (b & LCD_CDSHIFT_RL) ? 1 : -1 ;
+    else
+    {
+      int inc = s->increment ;
+
+      s->increment = (b & LCD_CDSHIFT_RL) != 0 ;
+      lcdSimStep (s) ;
+      s->increment = inc ;
+    }
+  }
+  else if (b & LCD_CTRL)
+  {
+    s->displayOn = (b & LCD_DISPLAY_CTRL) != 0 ;
+    s->cursorOn  = (b & LCD_CURSOR_CTRL)  != 0 ;
+    s->blinkOn   = (b & LCD_BLINK_CTRL)   != 0 ;
+  }
+  else if (b & LCD_ENTRY)
+  {
+    s->increment    = (b & LCD_ENTRY_ID) != 0 ;
+    s->shiftOnWrite = (b & LCD_ENTRY_SH) != 0 ;
+  }
+  else if (b & LCD_HOME)
+  {
+    s->ac    = 0 ;
+    s->cgram = 0 ;
+    s->shift = 0 ;
+    exec = LCDSIM_HOME_NS ;
+  }
+  else if (b & LCD_CLEAR)
+  {
+    lcdSimClear (s) ;
+    exec = LCDSIM_HOME_NS ;
+  }
+  return exec ;
+}
+
+/*
+ * E rising: checks the cycle and address setup times and, for a read,
+ * puts the right nibble on the data pins.
+ */
+static uint32_t lcdSimRise (struct lcdSim *s, uint32_t levels, uint32_t inputs, uint64_t now)
+{
+  uint64_t gap ;
+  unsigned char n ;
+
+  if (s->eRose != 0)
+  {
+    gap = now - s->eRose ;
+    if (gap < s->minCycleNs)
+      s->minCycleNs = gap ;
+    if (gap < LCDSIM_CYCLE_NS)
+      s->violations.cycle++ ;
+  }
+  if (now - s->ctrlChanged < LCDSIM_AS_NS)
+    s->violations.addressSetup++ ;
+  s->eRose = now ;
+
+  if (!(levels & s->rw))
+    return inputs ;
+
+  if (s->eightBit || !s->lowNibble)
+  {
+    if (levels & s->rs)
+      s->readByte = s->cgram ? s->cgramData [s->ac] : s->ddram [s->ac] ;
+    else
+      s->readByte = (now < s->busyUntil ? 0x80 : 0) | (s->ac & 0x7F) ;
+  }
+  n = (s->eightBit || !s->lowNibble) ? s->readByte >> 4 : s->readByte & 0x0F ;
+
+  return (inputs & ~lcdSimDataMask (s)) | lcdSimNibbleOut (s, n) ;
+}
+
+/*
+ * E falling: the controller latches what is on the bus.
+ */
+static uint32_t lcdSimFall (struct lcdSim *s, uint32_t levels, uint32_t inputs, uint64_t now)
+{
+  uint64_t width = now - s->eRose ;
+  unsigned char n ;
+  int rs = (levels & s->rs) != 0 ;
+  int done ;
+
+  if (width < s->minPulseNs)
+    s->minPulseNs = width ;
+  if (width < LCDSIM_PW_EH_NS)
+    s->violations.pulseWidth++ ;
+
+  // A read: let go of the bus, and count it once the whole byte is out
+  if (levels & s->rw)
+  {
+    done = s->eightBit || s->lowNibble ;
+    if (!s->eightBit)
+      s->lowNibble = !s->lowNibble ;
+    if (done)
+    {
+      s->reads++ ;
+      if (rs)
+        lcdSimStep (s) ;
+    }
+    return inputs & ~lcdSimDataMask (s) ;
+  }
+
+  if (now - s->dataChanged < s->minSetupNs)
+    s->minSetupNs = now - s->dataChanged ;
+  if (now - s->dataChanged < LCDSIM_DSW_NS)
+    s->violations.dataSetup++ ;
+
+  if (now < s->busyUntil)
+  {
+    s->violations.busy++ ;
+    return inputs ;
+  }
+
+  n = lcdSimNibbleIn (s, levels) ;
+  if (s->eightBit)
+    s->busyUntil = now + lcdSimExecute (s, rs, n << 4) ;	// D0-D3 aren't wired
+  else if (!s->lowNibble)
+  {
+    s->high      = n ;
+    s->lowNibble = 1 ;
+  }
+  else
+  {
+    s->lowNibble = 0 ;
+    s->busyUntil = now + lcdSimExecute (s, rs, (s->high << 4) | n) ;
+  }
+  return inputs ;
+}
+
+static uint32_t lcdSimObserve (void *arg, uint32_t levels, uint32_t inputs)
+{
+  struct lcdSim *s = arg ;
+  uint64_t now = timeNowNs () ;
+  uint32_t changed = levels ^ s->levels ;
+
+  if (changed & (s->rs | s->rw))
+    s->ctrlChanged = now ;
+  if (changed & lcdSimDataMask (s))
+    s->dataChanged = now ;
+
+  if (changed & s->e)
+    inputs = (levels & s->e) ? lcdSimRise (s, levels, inputs, now) : lcdSimFall (s, levels, inputs, now) ;
+
+  s->levels = levels ;
+  return inputs ;
+}
+
+/*
+ * Puts a controller fresh from power-on on the given pins, all in bank 0;
+ * @rw is -1 if R/W is tied low. Only one can be attached at a time, and
+ * only to the sim backend: returns -1 otherwise.
+ */
+int lcdSimAttach (struct lcdSim *s, int rs, int rw, int e, int d4, int d5, int d6, int d7)
+{
+  if (!gpioSimActive)
+    return -1 ;
+  if ((rs | e | d4 | d5 | d6 | d7) & ~31 || (rw >= 32))
+    return -1 ;
+
+  memset (s, 0, sizeof (*s)) ;
+  s->rs       = GPIO_BIT (rs) ;
+  s->rw       = rw < 0 ? 0 : GPIO_BIT (rw) ;
+  s->e        = GPIO_BIT (e) ;
+  s->data [0] = GPIO_BIT (d4) ;
+  s->data [1] = GPIO_BIT (d5) ;
+  s->data [2] = GPIO_BIT (d6) ;
+  s->data [3] = GPIO_BIT (d7) ;
+
+  s->eightBit = 1 ;
+  lcdSimClear (s) ;
+  s->levels     = gpio [GPLEV0] ;
+  s->minPulseNs = s->minCycleNs = s->minSetupNs = UINT64_MAX ;
+
+  gpioSimObserve (lcdSimObserve, s) ;
+  return 0 ;
+}
+
+void lcdSimDetach (struct lcdSim *s)
+{
+  gpioSimObserve (NULL, NULL) ;
+}
+
+/*
+ * What row @row of a display @cols wide shows, as character codes: @out
+ * gets @cols bytes and no terminator, as codes 0-7 are the CGRAM glyphs.
+ */
+void lcdSimRow (const struct lcdSim *s, int row, char *out, int cols)
+{
+  int base = row ? 0x40 : 0x00 ;
+  int len  = s->twoLines ? LCD_LINE_LEN : 80 ;
+  int c, col ;
+
+  for (c = 0 ; c < cols ; ++c)
+  {
+    col = ((c - s->shift) % len + len) % len ;
+    out [c] = s->ddram [base + col] ;
+  }
+}
+
+unsigned long lcdSimViolationCount (const struct lcdSim *s)
+{
+  const struct lcdSimViolations *v = &s->violations ;
+
+  return v->pulseWidth + v->cycle + v->addressSetup + v->dataSetup + v->busy ;
+}
@@ -0,0 +1,79 @@
+#ifndef LCDSIM_H
+#define LCDSIM_H
+
+#include <stdint.h>
+
+/*
+ * A simulated HD44780 on the sim GPIO backend. It watches RS, R/W, E and
+ * D4-D7 through gpioSimObserve() and does what the controller would: it
+ * latches a nibble on every falling edge of E, runs the 8-bit/4-bit
+ * interface state machine, executes instructions into DDRAM, CGRAM and
+ * the address counter, and answers busy flag reads on the data pins.
+ *
+ * Every edge is checked against the datasheet timings on timeNowNs()'s
+ * clock; a write that breaks one is counted, and one that arrives while
+ * the controller is still busy is lost, as it would be on the real thing.
+ * The smallest margins seen are kept, to show how far the driver's
+ * delays could shrink. On the fake clock only the driver's own waits
+ * move time on, so a setup time it leaves to the stores in between
+ * shows up as a violation there.
+ */
+
+#define	LCDSIM_PW_EH_NS		450		// E high, minimum
+#define	LCDSIM_CYCLE_NS		1000		// E rise to rise, minimum
+#define	LCDSIM_AS_NS		60		// RS, R/W before E rises
+#define	LCDSIM_DSW_NS		195		// data before E falls
+#define	LCDSIM_EXEC_NS		37000		// most instructions and data writes
+#define	LCDSIM_HOME_NS		1520000		// clear and home
+#define	LCDSIM_INIT1_NS		4100000		// after the first function set from reset
+#define	LCDSIM_INIT2_NS		100000		// after the second
+
+#define	LCDSIM_DDRAM		128		// by address: 0x00-0x27 and 0x40-0x67 are used
+#define	LCDSIM_CGRAM		64
+
+struct lcdSimViolations
+{
+  unsigned long pulseWidth ;		// E high too short
+  unsigned long cycle ;			// E strobed again too soon
+  unsigned long addressSetup ;		// RS or R/W changed just before E rose
+  unsigned long dataSetup ;		// data changed just before E fell
+  unsigned long busy ;			// written while busy, and lost
+} ;
+
+struct lcdSim
+{
+  // Wiring, as bank 0 bit masks
+  uint32_t rs, rw, e, data [4] ;
+
+  // Controller
+  int eightBit ;			// interface width, 8 from reset
+  int lowNibble ;			// 4-bit: the next nibble is the low half
+  int inits ;				// function sets seen in 8-bit mode
+  unsigned char high ;			// first half of a 4-bit transfer
+  unsigned char readByte ;		// what a 4-bit read is clocking out
+  int ac ;				// address counter
+  int cgram ;				// ac points into CGRAM
+  int increment, shiftOnWrite ;
+  int displayOn, cursorOn, blinkOn ;
+  int twoLines ;
+  int shift ;				// display shift, in columns
+  unsigned char ddram [LCDSIM_DDRAM] ;
+  unsigned char cgramData [LCDSIM_CGRAM] ;
+  uint64_t busyUntil ;
+
+  // Bus
+  uint32_t levels ;
+  uint64_t eRose, ctrlChanged, dataChanged ;
+
+  // What happened
+  unsigned long instructions, writes, reads ;
+  struct lcdSimViolations violations ;
+  uint64_t minPulseNs, minCycleNs, minSetupNs ;
+} ;
+
+int  lcdSimAttach  (struct lcdSim *s, int rs, int rw, int e, int d4, int d5, int d6, int d7) ;
+void lcdSimDetach  (struct lcdSim *s) ;
+void lcdSimRow     (const struct lcdSim *s, int row, char *out, int cols) ;
+unsigned long lcdSimViolationCount (const struct lcdSim *s) ;
+
+#endif
@@ -0,0 +1,224 @@
+#include <pthread.h>
+#include <stdint.h>
+
+#include "gpio.h"
+#include "timing.h"
+#include "leds.h"
+
+#define	TICK_NS		(LEDS_TICK_MS * 1000000ULL)
+
+struct ledTrack
+{
+  struct ledStep queue [LEDS_QUEUE] ;
+  unsigned int head, tail ;		// queue [head] is playing while it's on the wheel
+  int playing ;
+  uint64_t due ;			// when the playing step ends
+  uint64_t dueTick ;
+  struct ledTrack *next ;		// in its wheel slot
+} ;
+
+static struct
+{
+  pthread_mutex_t lock ;
+  pthread_cond_t  ready, idle ;
+  struct ledTrack tracks [LEDS_TRACKS] ;
+  struct ledTrack *wheel [LEDS_WHEEL] ;
+  uint64_t tick ;			// last tick handled
+  int active ;				// tracks on the wheel
+  int stop ;
+  pthread_t thread ;
+} leds = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER } ;
+
+/*
+ * Puts @t in the slot of the tick its step ends on; a step longer than the
+ * wheel just stays in its slot for more than one turn.
+ */
+static void wheelAdd (struct ledTrack *t)
+{
+  struct ledTrack **slot ;
+
+  t->dueTick = (t->due + TICK_NS - 1) / TICK_NS ;
+  if (t->dueTick <= leds.tick)
+    t->dueTick = leds.tick + 1 ;
+
+  slot = &leds.wheel [t->dueTick % LEDS_WHEEL] ;
+  t->next = *slot ;
+  *slot   = t ;
+  t->playing = 1 ;
+  leds.active++ ;
+}
+
+/*
+ * Plays the steps at the head of @t's queue from @start: zero-length ones
+ * at once, up to the first that has to be held, which goes on the wheel.
+ */
+static void trackStart (struct ledTrack *t, uint64_t start)
+{
+  while (t->head != t->tail)
+  {
+    struct ledStep *s = &t->queue [t->head % LEDS_QUEUE] ;
+
+    gpioWrite (s->pin, s->level) ;
+    if (s->ms > 0)
+    {
+      t->due = start + s->ms * 1000000ULL ;
+      wheelAdd (t) ;
+      return ;
+    }
+    t->head++ ;
+  }
+}
+
+// Ends the steps due on the current tick and starts whatever follows them
+static void wheelTurn (void)
+{
+  struct ledTrack **slot = &leds.wheel [leds.tick % LEDS_WHEEL] ;
+  struct ledTrack *t = *slot, *next ;
+
+  *slot = NULL ;
+  for ( ; t != NULL ; t = next)
+  {
+    next = t->next ;
+    if (t->dueTick > leds.tick)
+    {
+      t->next = *slot ;
+      *slot   = t ;
+      continue ;
+    }
+    t->playing = 0 ;
+    leds.active-- ;
+    t->head++ ;
+    trackStart (t, t->due) ;		// from when the last step ended, so timing doesn't drift
+  }
+}
+
+static int ledsIdle (void)
+{
+  int i ;
+
+  for (i = 0 ; i < LEDS_TRACKS ; ++i)
+    if (leds.tracks [i].head != leds.tracks [i].tail)
+      return 0 ;
+  return 1 ;
+}
+
+static void *ledsThread (void *arg)
+{
+  uint64_t now, nowTick ;
+  int i ;
+
+  pthread_mutex_lock (&leds.lock) ;
+  while (!leds.stop)
+  {
+    now = timeNowNs () ;
+    if (leds.active == 0)
+      leds.tick = now / TICK_NS ;
+    for (i = 0 ; i < LEDS_TRACKS ; ++i)
+      if (!leds.tracks [i].playing)
+        trackStart (&leds.tracks [i], now) ;
+
+    if (leds.active == 0)
+    {
+      pthread_cond_broadcast (&leds.idle) ;
+      pthread_cond_wait (&leds.ready, &leds.lock) ;
+      continue ;
+    }
+
+    pthread_mutex_unlock (&leds.lock) ;
+    delayUntil ((leds.tick + 1) * TICK_NS) ;
+    pthread_mutex_lock (&leds.lock) ;
+
+    nowTick = timeNowNs () / TICK_NS ;
+    while (leds.tick < nowTick)
+    {
+      leds.tick++ ;
+      wheelTurn () ;
+    }
+  }
+  pthread_mutex_unlock (&leds.lock) ;
+  return arg ;
+}
+
+int ledsStart (void)
+{
+  leds.stop = 0 ;
+  return pthread_create (&leds.thread, NULL, ledsThread, NULL) == 0 ? 0 : -1 ;
+}
+
+/*
+ * Stops the engine where it is; steps still queued are dropped.
+ */
+void ledsStop (void)
+{
+  int i ;
+
+  pthread_mutex_lock (&leds.lock) ;
+  leds.stop = 1 ;
+  pthread_cond_signal (&leds.ready) ;
+  pthread_mutex_unlock (&leds.lock) ;
+  pthread_join (leds.thread, NULL) ;
+
+  for (i = 0 ; i < LEDS_WHEEL ; ++i)
+    leds.wheel [i] = NULL ;
+  for (i = 0 ; i < LEDS_TRACKS ; ++i)
+    leds.tracks [i].head = leds.tracks [i].tail = leds.tracks [i].playing = 0 ;
+  leds.active = 0 ;
+}
+
+/*
+ * Queues @count steps on @track, to play after what is already there.
+ * Returns 0, or -1 for a bad track or if the queue has no room.
+ */
+int ledsPlay (int track, const struct ledStep *steps, int count)
+{
+  struct ledTrack *t ;
+  int i ;
+
+  if (track < 0 || track >= LEDS_TRACKS || count < 0)
+    return -1 ;
+  t = &leds.tracks [track] ;
+
+  pthread_mutex_lock (&leds.lock) ;
+  if (t->tail - t->head + count > LEDS_QUEUE)
+  {
+    pthread_mutex_unlock (&leds.lock) ;
+    return -1 ;
+  }
+  for (i = 0 ; i < count ; ++i)
+    t->queue [t->tail++ % LEDS_QUEUE] = steps [i] ;
+  pthread_cond_signal (&leds.ready) ;
+  pthread_mutex_unlock (&leds.lock) ;
+  return 0 ;
+}
+
+/*
+ * Queues @count blinks of @pin: on for @onMs, then off for @offMs.
+ */
+int ledsBlink (int track, int pin, int count, unsigned int onMs, unsigned int offMs)
+{
+  struct ledStep steps [LEDS_QUEUE] ;
+  int i ;
+
+  if (count <= 0)
+    return 0 ;
+  if (count > LEDS_QUEUE / 2)
+    return -1 ;
+
+  for (i = 0 ; i < count ; ++i)
+  {
+    steps [2 * i].pin       = pin ; steps [2 * i].level     = HIGH ; steps [2 * i].ms     = onMs ;
+    steps [2 * i + 1].pin   = pin ; steps [2 * i + 1].level = LOW ;  steps [2 * i + 1].ms = offMs ;
+  }
+  return ledsPlay (track, steps, 2 * count) ;
+}
+
+/*
+ * Blocks until every track has played everything queued on it.
+ */
+void ledsWait (void)
+{
+  pthread_mutex_lock (&leds.lock) ;
+  while (!ledsIdle ())
+    pthread_cond_wait (&leds.idle, &leds.lock) ;
+  pthread_mutex_unlock (&leds.lock) ;
+}
@@ -0,0 +1,33 @@
+#ifndef LEDS_H
+#define LEDS_H
+
+/*
+ * LED effects engine. A pattern is a list of steps, each setting a pin to
+ * a level and holding it for a while. Patterns are queued on a track and
+ * play in order; tracks play at the same time as each other, so one LED
+ * can stay lit while another blinks. Queueing never waits for the LEDs.
+ *
+ * One thread runs every track off a timer wheel: each track's current
+ * step sits in the wheel slot of the tick it ends on, and the thread
+ * sleeps from tick to tick, only looking at the slot that is due.
+ */
+
+#define	LEDS_TRACKS	4
+#define	LEDS_QUEUE	256		// steps waiting per track
+#define	LEDS_TICK_MS	5
+#define	LEDS_WHEEL	256		// slots, one tick each
+
+struct ledStep
+{
+  int pin ;
+  int level ;
+  unsigned int ms ;			// how long to hold it before the next step
+} ;
+
+int  ledsStart (void) ;
+void ledsStop  (void) ;
+int  ledsPlay  (int track, const struct ledStep *steps, int count) ;
+int  ledsBlink (int track, int pin, int count, unsigned int onMs, unsigned int offMs) ;
+void ledsWait  (void) ;
+
+#endif
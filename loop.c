@@ -0,0 +1,256 @@
+#define	_GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "timing.h"
+#include "loop.h"
+
+int loopInit (struct loop *l)
+{
+  memset (l, 0, sizeof (*l)) ;
+  l->cmdFd [0] = l->cmdFd [1] = -1 ;
+
+  if ((l->timerFd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+    return -1 ;
+  if (pipe2 (l->cmdFd, O_NONBLOCK | O_CLOEXEC) != 0)
+  {
+    close (l->timerFd) ;
+    return -1 ;
+  }
+
+  l->fds [0].fd     = l->timerFd ;
+  l->fds [0].events = POLLIN ;
+  l->fds [1].fd     = l->cmdFd [0] ;
+  l->fds [1].events = POLLIN ;
+  return 0 ;
+}
+
+void loopClose (struct loop *l)
+{
+  close (l->timerFd) ;
+  close (l->cmdFd [0]) ;
+  close (l->cmdFd [1]) ;
+  l->timerFd = l->cmdFd [0] = l->cmdFd [1] = -1 ;
+}
+
+/*
+ * Calls @ready whenever @fd has something to read. @ready has to read it,
+ * or it is called again straight away.
+ */
+int loopWatch (struct loop *l, int fd, void (*ready)(void *arg), void *arg)
+{
+  int n = l->nWatches ;
+
+  if (n == LOOP_WATCHES)
+    return -1 ;
+
+  l->watches [n].fd    = fd ;
+  l->watches [n].ready = ready ;
+  l->watches [n].arg   = arg ;
+  l->fds [2 + n].fd     = fd ;
+  l->fds [2 + n].events = POLLIN ;
+  l->nWatches++ ;
+  return 0 ;
+}
+
+void loopUnwatch (struct loop *l, int fd)
+{
+  int i ;
+
+  for (i = 0 ; i < l->nWatches ; ++i)
+    if (l->watches [i].fd == fd)
+    {
+      l->nWatches-- ;
+      l->watches [i]  = l->watches [l->nWatches] ;
+      l->fds [2 + i]  = l->fds [2 + l->nWatches] ;
+      return ;
+    }
+}
+
+void loopTimerInit (struct loopTimer *t, void (*fire)(void *arg), void *arg)
+{
+  t->due    = 0 ;
+  t->fire   = fire ;
+  t->arg    = arg ;
+  t->armed  = 0 ;
+  t->serial = 0 ;
+}
+
+/*
+ * Fires @t once at @due, instead of whenever it was set for before.
+ * A deadline that has already passed fires on the loop's next turn.
+ */
+int loopTimerSet (struct loop *l, struct loopTimer *t, uint64_t due)
+{
+  if (!t->armed)
+  {
+    if (l->nTimers == LOOP_TIMERS)
+      return -1 ;
+    l->timers [l->nTimers++] = t ;
+    t->armed = 1 ;
+  }
+  t->due    = due ;
+  t->serial = ++l->serials ;
+  return 0 ;
+}
+
+void loopTimerCancel (struct loop *l, struct loopTimer *t)
+{
+  int i ;
+
+  if (!t->armed)
+    return ;
+
+  for (i = 0 ; i < l->nTimers ; ++i)
+    if (l->timers [i] == t)
+    {
+      l->timers [i] = l->timers [--l->nTimers] ;
+      break ;
+    }
+  t->armed = 0 ;
+}
+
+void loopOnCommand (struct loop *l, void (*command)(void *arg, int cmd), void *arg)
+{
+  l->command    = command ;
+  l->commandArg = arg ;
+}
+
+int loopPost (struct loop *l, int cmd)
+{
+  unsigned char c = cmd ;
+
+  return write (l->cmdFd [1], &c, 1) == 1 ? 0 : -1 ;
+}
+
+void loopStop (struct loop *l)
+{
+  l->stop = 1 ;
+}
+
+// The earliest timer set by the @serial'th loopTimerSet() or before
+static struct loopTimer *loopEarliest (struct loop *l, unsigned long serial)
+{
+  struct loopTimer *first = NULL ;
+  int i ;
+
+  for (i = 0 ; i < l->nTimers ; ++i)
+    if (l->timers [i]->serial <= serial && (first == NULL || l->timers [i]->due < first->due))
+      first = l->timers [i] ;
+  return first ;
+}
+
+// Keeps the timerfd armed for the earliest deadline, touching it only when that changes
+static int loopArm (struct loop *l)
+{
+  struct loopTimer *first = loopEarliest (l, l->serials) ;
+  struct itimerspec its ;
+  uint64_t due = first == NULL ? 0 : first->due ;
+
+  if (first != NULL && due == 0)
+    due = 1 ;				// an all-zero time would disarm it
+  if (due == l->timerDue)
+    return 0 ;
+
+  memset (&its, 0, sizeof (its)) ;
+  if (first != NULL)
+  {
+    its.it_value.tv_sec  = due / 1000000000ULL ;
+    its.it_value.tv_nsec = due % 1000000000ULL ;
+  }
+  if (timerfd_settime (l->timerFd, TFD_TIMER_ABSTIME, &its, NULL) != 0)
+    return -1 ;
+  l->timerDue = due ;
+  return 0 ;
+}
+
+/*
+ * Fires everything due by now, earliest first. A timer a handler sets
+ * again waits for the next turn, even if it is already due, so one that
+ * keeps re-arming itself can't keep poll() from running.
+ */
+static void loopExpire (struct loop *l)
+{
+  struct loopTimer *t ;
+  uint64_t now = timeNowNs () ;
+  unsigned long serial = l->serials ;
+
+  while ((t = loopEarliest (l, serial)) != NULL && t->due <= now)
+  {
+    loopTimerCancel (l, t) ;
+    t->fire (t->arg) ;
+  }
+}
+
+static void loopCommands (struct loop *l)
+{
+  unsigned char cmds [16] ;
+  ssize_t n, i ;
+
+  while ((n = read (l->cmdFd [0], cmds, sizeof (cmds))) > 0)
+    for (i = 0 ; i < n && l->command != NULL ; ++i)
+      l->command (l->commandArg, cmds [i]) ;
+}
+
+/*
+ * Runs handlers until one of them calls loopStop(). Returns 0 then, or -1
+ * if poll() or the timerfd fails.
+ */
+int loopRun (struct loop *l)
+{
+  struct loopWatch ready [LOOP_WATCHES] ;
+  struct loopTimer *first ;
+  uint64_t ticks ;
+  int i, j, n, nReady, fake ;
+
+  l->stop = 0 ;
+  while (!l->stop)
+  {
+    fake = timeIsFake () ;
+    if (!fake && loopArm (l) != 0)
+      return -1 ;
+
+    n = poll (l->fds, 2 + l->nWatches, fake && l->nTimers > 0 ? 0 : -1) ;
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue ;
+      return -1 ;
+    }
+
+    // Nothing else can happen before the next deadline, so go straight there
+    if (n == 0 && fake && (first = loopEarliest (l, l->serials)) != NULL)
+      delayUntil (first->due) ;
+
+    // Handlers may add and remove watches, so take note of what poll() saw first
+    for (i = nReady = 0 ; i < l->nWatches ; ++i)
+      if (l->fds [2 + i].revents != 0)
+        ready [nReady++] = l->watches [i] ;
+
+    if (l->fds [0].revents & POLLIN)
+    {
+      while (read (l->timerFd, &ticks, sizeof (ticks)) > 0)
+        ;
+      l->timerDue = 0 ;
+    }
+    loopExpire (l) ;
+
+    if (l->fds [1].revents & POLLIN)
+      loopCommands (l) ;
+
+    for (i = 0 ; i < nReady && !l->stop ; ++i)
+      for (j = 0 ; j < l->nWatches ; ++j)
+        if (l->watches [j].fd == ready [i].fd && l->watches [j].ready == ready [i].ready)
+        {
+          ready [i].ready (ready [i].arg) ;
+          break ;
+        }
+  }
+  return 0 ;
+}
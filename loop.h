@@ -0,0 +1,69 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include <stdint.h>
+#include <poll.h>
+
+/*
+ * Event loop. Everything the game waits on is either a file descriptor
+ * (button edges, commands) or a deadline, so one thread can sit in poll()
+ * on all of them at once and run whichever is ready. Handlers must not
+ * block; anything that takes time is a deadline for a later callback.
+ *
+ * Deadlines are on timeNowNs()'s clock. One timerfd is kept armed for the
+ * earliest of them, so poll() wakes for it like any other fd. With the
+ * fake clock the loop jumps the clock to the next deadline instead,
+ * whenever nothing else is ready.
+ *
+ * Commands are single bytes written to a pipe by loopPost(), which only
+ * calls write() and so is safe from other threads and signal handlers.
+ */
+
+#define	LOOP_WATCHES	8
+#define	LOOP_TIMERS	8
+
+struct loopTimer
+{
+  uint64_t due ;
+  void (*fire)(void *arg) ;
+  void *arg ;
+  int armed ;
+  unsigned long serial ;		// which loopTimerSet() armed it
+} ;
+
+struct loopWatch
+{
+  int fd ;
+  void (*ready)(void *arg) ;
+  void *arg ;
+} ;
+
+struct loop
+{
+  struct pollfd fds [2 + LOOP_WATCHES] ;	// timerfd, command pipe, then the watches
+  struct loopWatch watches [LOOP_WATCHES] ;
+  int nWatches ;
+  struct loopTimer *timers [LOOP_TIMERS] ;
+  int nTimers ;
+  int timerFd ;
+  uint64_t timerDue ;				// what timerFd is armed for, 0 if not
+  unsigned long serials ;			// loopTimerSet() calls so far
+  int cmdFd [2] ;
+  void (*command)(void *arg, int cmd) ;
+  void *commandArg ;
+  int stop ;
+} ;
+
+int  loopInit        (struct loop *l) ;
+void loopClose       (struct loop *l) ;
+int  loopWatch       (struct loop *l, int fd, void (*ready)(void *arg), void *arg) ;
+void loopUnwatch     (struct loop *l, int fd) ;
+void loopTimerInit   (struct loopTimer *t, void (*fire)(void *arg), void *arg) ;
+int  loopTimerSet    (struct loop *l, struct loopTimer *t, uint64_t due) ;
+void loopTimerCancel (struct loop *l, struct loopTimer *t) ;
+void loopOnCommand   (struct loop *l, void (*command)(void *arg, int cmd), void *arg) ;
+int  loopPost        (struct loop *l, int cmd) ;
+int  loopRun         (struct loop *l) ;
+void loopStop        (struct loop *l) ;
+
+#endif
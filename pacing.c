@@ -0,0 +1,135 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pacing.h"
+
+static const struct pacing presets[] = {
+  { "normal", 3000, 1000, 300, 200, 1500, 0 },
+  { "fast",      0,    0,   0,   0, 1500, 0 },
+};
+
+int pacingPreset(struct pacing *pace, const char *name) {
+
+  unsigned i;
+
+  for(i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+    if(strcmp(name, presets[i].name) == 0) {
+      *pace = presets[i];
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Sets one key. "pace" takes a preset name or, failing that, a file to
+ * load. Returns -1 for an unknown key or a bad value.
+ */
+int pacingSet(struct pacing *pace, const char *key, const char *value) {
+
+  unsigned *field = NULL;
+  char *end;
+  unsigned long n;
+
+  if(strcmp(key, "pace") == 0) {
+    if(pacingPreset(pace, value) == 0) {
+      return 0;
+    }
+    return pacingLoad(pace, value);
+  }
+
+  if(strcmp(key, "resultHoldMs") == 0) field = &pace->resultHoldMs;
+  if(strcmp(key, "roundPauseMs") == 0) field = &pace->roundPauseMs;
+  if(strcmp(key, "blinkOnMs") == 0)    field = &pace->blinkOnMs;
+  if(strcmp(key, "blinkOffMs") == 0)   field = &pace->blinkOffMs;
+  if(strcmp(key, "digitWindowMs") == 0) field = &pace->digitWindowMs;
+
+  n = strtoul(value, &end, 10);
+  if(*value == '\0' || *end != '\0' || n > 60000) {
+    return -1;
+  }
+  if(strcmp(key, "fakeClock") == 0) {
+    pace->fakeClock = n != 0;
+  } else if(field == NULL) {
+    return -1;
+  } else {
+    *field = n;
+  }
+  pace->name = "custom";
+  return 0;
+}
+
+/*
+ * A "key=value" command line argument. Returns 1 if @arg has no '=', so
+ * the caller can try it as something else; anything with one is a
+ * setting, and -1 if it isn't a good one.
+ */
+int pacingArg(struct pacing *pace, const char *arg) {
+
+  char key[32];
+  const char *eq = strchr(arg, '=');
+
+  if(eq == NULL) {
+    return 1;
+  }
+  if(eq - arg >= (int)sizeof(key)) {
+    return -1;
+  }
+  memcpy(key, arg, eq - arg);
+  key[eq - arg] = '\0';
+  return pacingSet(pace, key, eq + 1);
+}
+
+static char *trim(char *s) {
+
+  char *end;
+
+  while(isspace((unsigned char)*s)) {
+    s++;
+  }
+  end = s + strlen(s);
+  while(end > s && isspace((unsigned char)end[-1])) {
+    *--end = '\0';
+  }
+  return s;
+}
+
+int pacingLoad(struct pacing *pace, const char *path) {
+
+  FILE *f = fopen(path, "r");
+  char line[256], *eq, *hash;
+  int lineNo = 0, result = 0;
+
+  if(f == NULL) {
+    return -1;
+  }
+  while(fgets(line, sizeof(line), f) != NULL) {
+    lineNo++;
+    if((hash = strchr(line, '#')) != NULL) {
+      *hash = '\0';
+    }
+    if(*trim(line) == '\0') {
+      continue;
+    }
+    if((eq = strchr(line, '=')) == NULL) {
+      fprintf(stderr, "%s:%d: expected key = value\n", path, lineNo);
+      result = -1;
+      continue;
+    }
+    *eq = '\0';
+    // A file can't load another, or itself
+    if(strcmp(trim(line), "pace") == 0) {
+      fprintf(stderr, "%s:%d: pace can't be set from a pacing file\n", path, lineNo);
+      result = -1;
+      continue;
+    }
+    if(pacingSet(pace, trim(line), trim(eq + 1)) != 0) {
+      fprintf(stderr, "%s:%d: bad setting for %s\n", path, lineNo, trim(line));
+      result = -1;
+    }
+  }
+  fclose(f);
+  return result;
+}
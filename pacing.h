@@ -0,0 +1,30 @@
+#ifndef PACING_H
+#define PACING_H
+
+/*
+ * How long the game keeps things on show. "normal" is the pacing the game
+ * has always had; "fast" drops every presentation delay to zero, for
+ * tests, kiosks and simulation. Input timing (how long a digit waits for
+ * its first press) is the player's, not presentation, and is kept.
+ *
+ * A profile can be loaded from a file of "key = value" lines, where
+ * '#' starts a comment, or set key by key from the command line. A file
+ * can't set "pace" itself. On the command line "pace=" is applied before
+ * any other key, so a key given with it is kept whatever the order.
+ */
+
+struct pacing {
+  const char *name;
+  unsigned resultHoldMs;   // a scored guess stays up this long...
+  unsigned roundPauseMs;   // ...and this much more before the next round
+  unsigned blinkOnMs, blinkOffMs;
+  unsigned digitWindowMs;  // per colour: a digit with no press is 0 after numRange times this
+  int fakeClock;           // solver games only: jump to each deadline instead of sleeping
+};
+
+int pacingPreset(struct pacing *pace, const char *name);
+int pacingSet(struct pacing *pace, const char *key, const char *value);
+int pacingArg(struct pacing *pace, const char *arg);
+int pacingLoad(struct pacing *pace, const char *path);
+
+#endif
@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "pool.h"
+
+/*
+ * Takes the next grain from the front of slice @id. Returns 0 when the
+ * slice is empty.
+ */
+static int takeOwn(struct pool *pool, int id, long *begin, long *end) {
+
+  struct poolSlice *slice = &pool->slices[id];
+  int found = 0;
+
+  pthread_mutex_lock(&slice->lock);
+  if(slice->begin < slice->end) {
+    *begin = slice->begin;
+    *end = (slice->end - slice->begin > pool->grain) ? slice->begin + pool->grain : slice->end;
+    slice->begin = *end;
+    found = 1;
+  }
+  pthread_mutex_unlock(&slice->lock);
+  return found;
+}
+
+/*
+ * Steals the back half of the fullest other slice and makes it the new
+ * slice of worker @id. Returns 0 when there is nothing left anywhere.
+ */
+static int steal(struct pool *pool, int id) {
+
+  long most = 0, begin = 0, end = 0;
+  int victim = -1, x;
+
+  for(x = 1; x < pool->threads; x++) {
+    struct poolSlice *slice = &pool->slices[(id + x) % pool->threads];
+    long left;
+
+    pthread_mutex_lock(&slice->lock);
+    left = slice->end - slice->begin;
+    pthread_mutex_unlock(&slice->lock);
+    if(left > most) {
+      most = left;
+      victim = (id + x) % pool->threads;
+    }
+  }
+  if(victim < 0) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&pool->slices[victim].lock);
+  if(pool->slices[victim].begin < pool->slices[victim].end) {
+    struct poolSlice *slice = &pool->slices[victim];
+
+    begin = slice->begin + (slice->end - slice->begin) / 2;
+    end = slice->end;
+    slice->end = begin;
+  }
+  pthread_mutex_unlock(&pool->slices[victim].lock);
+
+  pthread_mutex_lock(&pool->slices[id].lock);
+  pool->slices[id].begin = begin;
+  pool->slices[id].end = end;
+  pthread_mutex_unlock(&pool->slices[id].lock);
+
+  // Even if another thief emptied the victim first, there may be more to steal
+  return 1;
+}
+
+static void work(struct pool *pool, int id) {
+
+  long begin, end;
+
+  for(;;) {
+    while(takeOwn(pool, id, &begin, &end)) {
+      pool->fn(pool->arg, begin, end, id);
+    }
+    if(!steal(pool, id)) {
+      return;
+    }
+  }
+}
+
+static void *worker(void *arg) {
+
+  struct pool *pool = ((void **)arg)[0];
+  int id = (int)(long)((void **)arg)[1];
+  unsigned seen = 0;
+
+  free(arg);
+  for(;;) {
+    pthread_mutex_lock(&pool->lock);
+    while(pool->generation == seen && !pool->quit) {
+      pthread_cond_wait(&pool->start, &pool->lock);
+    }
+    if(pool->quit) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+
+    work(pool, id);
+
+    pthread_mutex_lock(&pool->lock);
+    if(--pool->running == 0) {
+      pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+/*
+ * Number of online CPUs, at least 1.
+ */
+int poolDefaultThreads(void) {
+
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return n > 0 ? (int)n : 1;
+}
+
+/*
+ * Starts @threads - 1 helper threads (the caller of poolRun() is the
+ * last one). Returns 0 on success, -1 on failure.
+ */
+int poolInit(struct pool *pool, int threads) {
+
+  int x;
+
+  pool->threads = threads < 1 ? 1 : threads;
+  pool->generation = 0;
+  pool->running = 0;
+  pool->quit = 0;
+  pool->ids = calloc(pool->threads, sizeof(*pool->ids));
+  pool->slices = aligned_alloc(64, pool->threads * sizeof(*pool->slices));
+  if(pool->ids == NULL || pool->slices == NULL) {
+    free(pool->ids);
+    free(pool->slices);
+    return -1;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->done, NULL);
+
+  for(x = 0; x < pool->threads; x++) {
+    pthread_mutex_init(&pool->slices[x].lock, NULL);
+    pool->slices[x].begin = pool->slices[x].end = 0;
+  }
+  for(x = 1; x < pool->threads; x++) {
+    void **arg = malloc(2 * sizeof(void *));
+
+    if(arg == NULL) {
+      break;
+    }
+    arg[0] = pool;
+    arg[1] = (void *)(long)x;
+    if(pthread_create(&pool->ids[x], NULL, worker, arg) != 0) {
+      free(arg);
+      break;
+    }
+  }
+  // Run with however many threads we managed to start
+  pool->threads = x;
+  return 0;
+}
+
+/*
+ * Calls @fn over [0, @count) in chunks of at most @grain indexes and
+ * returns once every index has been handled. @fn must not care which
+ * worker runs which chunk.
+ */
+void poolRun(struct pool *pool, long count, long grain, poolFn fn, void *arg) {
+
+  int x;
+
+  pool->fn = fn;
+  pool->arg = arg;
+  pool->grain = grain < 1 ? 1 : grain;
+  for(x = 0; x < pool->threads; x++) {
+    pool->slices[x].begin = count * x / pool->threads;
+    pool->slices[x].end = count * (x + 1) / pool->threads;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->running = pool->threads - 1;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  work(pool, 0);
+
+  pthread_mutex_lock(&pool->lock);
+  while(pool->running > 0) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void poolFree(struct pool *pool) {
+
+  int x;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = 1;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  for(x = 1; x < pool->threads; x++) {
+    pthread_join(pool->ids[x], NULL);
+  }
+  for(x = 0; x < pool->threads; x++) {
+    pthread_mutex_destroy(&pool->slices[x].lock);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->start);
+  pthread_cond_destroy(&pool->done);
+  free(pool->ids);
+  free(pool->slices);
+}
@@ -0,0 +1,40 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+/*
+ * A small work-stealing thread pool for loops over an index range. Each
+ * worker starts with an equal slice of the range and eats it from the
+ * front a grain at a time; a worker that runs dry steals the back half of
+ * the largest slice it can find. The calling thread works as worker 0.
+ */
+typedef void (*poolFn)(void *arg, long begin, long end, int worker);
+
+struct poolSlice {
+  pthread_mutex_t lock;
+  long begin, end;
+} __attribute__((aligned(64)));
+
+struct pool {
+  int threads;
+  pthread_t *ids;
+  struct poolSlice *slices;
+
+  pthread_mutex_t lock;
+  pthread_cond_t start, done;
+  unsigned generation;
+  int running, quit;
+
+  poolFn fn;
+  void *arg;
+  long grain;
+};
+
+int poolInit(struct pool *pool, int threads);
+void poolRun(struct pool *pool, long count, long grain, poolFn fn, void *arg);
+void poolFree(struct pool *pool);
+
+int poolDefaultThreads(void);
+
+#endif
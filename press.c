@@ -0,0 +1,129 @@
+#include <string.h>
+
+#include "press.h"
+
+#define	MS	1000000ULL
+
+static const struct pressConfig pressDefaults = { PRESS_DEBOUNCE_MS, PRESS_LONG_MS, PRESS_GAP_MS } ;
+
+/*
+ * Sets up a decoder for digits of 1 to @maxCount presses. A NULL @cfg
+ * gives the PRESS_* defaults.
+ */
+void pressInit (struct pressDecoder *d, const struct pressConfig *cfg, int maxCount)
+{
+  memset (d, 0, sizeof (*d)) ;
+  d->cfg      = cfg ? *cfg : pressDefaults ;
+  d->maxCount = maxCount ;
+}
+
+/*
+ * Forgets the digit in progress, e.g. before a new guess. The button level
+ * is kept, since it is still held if it was.
+ */
+void pressReset (struct pressDecoder *d)
+{
+  d->count = 0 ;
+}
+
+static int pressDigit (struct pressDecoder *d)
+{
+  int digit = d->count ;
+
+  d->count = 0 ;
+  return digit ;
+}
+
+/*
+ * The debounced level changes at @t: a press starts, or one ends and is
+ * classified. Returns a finished digit or -1.
+ */
+static int pressSettle (struct pressDecoder *d, uint64_t t)
+{
+  if (d->raw == d->stable)
+    return -1 ;
+
+  d->stable   = d->raw ;
+  d->lastEdge = t ;
+
+  if (d->stable)
+  {
+    d->pressedAt = t ;
+    return -1 ;
+  }
+
+  d->releasedAt = t ;
+  if (d->count < d->maxCount)
+    d->count++ ;
+
+  if (t - d->pressedAt >= d->cfg.longPressMs * MS)
+  {
+    d->longPresses++ ;
+    return pressDigit (d) ;
+  }
+  d->shortPresses++ ;
+  return -1 ;
+}
+
+/*
+ * Lets time pass up to @now with no new edge. Returns a digit if the gap
+ * after the last press has run out, otherwise -1.
+ */
+int pressTick (struct pressDecoder *d, uint64_t now)
+{
+  uint64_t settle = d->lastEdge + d->cfg.debounceMs * MS ;
+  int digit ;
+
+  if (d->raw != d->stable && now >= settle)
+  {
+    digit = pressSettle (d, settle) ;
+    if (digit >= 0)
+      return digit ;
+  }
+
+  if (d->count > 0 && !d->stable && d->raw == d->stable && now >= d->releasedAt + d->cfg.digitGapMs * MS)
+    return pressDigit (d) ;
+
+  return -1 ;
+}
+
+/*
+ * Feeds in one edge. Returns a digit if one finished, otherwise -1.
+ */
+int pressEdge (struct pressDecoder *d, const struct buttonEvent *ev)
+{
+  // A gap that ran out before this edge ends the digit first
+  int digit = pressTick (d, ev->timeNs) ;
+  int settled ;
+
+  d->raw = ev->level ;
+  if (ev->timeNs < d->lastEdge + d->cfg.debounceMs * MS)
+  {
+    d->bounces++ ;
+    return digit ;
+  }
+
+  settled = pressSettle (d, ev->timeNs) ;
+  return digit >= 0 ? digit : settled ;
+}
+
+/*
+ * When pressTick() next has something to do, or 0 if only an edge can
+ * change anything.
+ */
+uint64_t pressDeadline (const struct pressDecoder *d)
+{
+  if (d->raw != d->stable)
+    return d->lastEdge + d->cfg.debounceMs * MS ;
+  if (d->count > 0 && !d->stable)
+    return d->releasedAt + d->cfg.digitGapMs * MS ;
+  return 0 ;
+}
+
+/*
+ * True if no digit has been started: not a press yet and the button up.
+ */
+int pressIdle (const struct pressDecoder *d)
+{
+  return d->count == 0 && !d->stable && d->raw == d->stable ;
+}
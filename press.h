@@ -0,0 +1,48 @@
+#ifndef PRESS_H
+#define PRESS_H
+
+#include <stdint.h>
+
+#include "button.h"
+
+/*
+ * Turns button edges into digits. A digit is a number of presses; it ends
+ * when the button has been left alone for digitGapMs after the last one,
+ * or straight away on a long press (which counts as a press too). Edges
+ * within debounceMs of the last accepted one are contact bounce; the level
+ * they leave the button at is taken once that window has passed.
+ *
+ * The decoder only looks at the timestamps it is given, so it runs the
+ * same on kernel events, injected ones and a fake clock.
+ */
+
+#define	PRESS_DEBOUNCE_MS	20
+#define	PRESS_LONG_MS		800
+#define	PRESS_GAP_MS		600
+
+struct pressConfig
+{
+  unsigned debounceMs ;
+  unsigned longPressMs ;
+  unsigned digitGapMs ;
+} ;
+
+struct pressDecoder
+{
+  struct pressConfig cfg ;
+  int maxCount ;			// presses beyond this are ignored
+  int stable, raw ;			// debounced and last seen level
+  uint64_t lastEdge ;			// when stable last changed
+  uint64_t pressedAt, releasedAt ;
+  int count ;				// presses so far in this digit
+  unsigned long bounces, shortPresses, longPresses ;
+} ;
+
+void     pressInit     (struct pressDecoder *d, const struct pressConfig *cfg, int maxCount) ;
+void     pressReset    (struct pressDecoder *d) ;
+int      pressEdge     (struct pressDecoder *d, const struct buttonEvent *ev) ;
+int      pressTick     (struct pressDecoder *d, uint64_t now) ;
+uint64_t pressDeadline (const struct pressDecoder *d) ;
+int      pressIdle     (const struct pressDecoder *d) ;
+
+#endif
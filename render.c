@@ -0,0 +1,196 @@
+#define	_GNU_SOURCE
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "timing.h"
+#include "lcd.h"
+#include "render.h"
+
+/*
+ * Each slot is a seqlock. The producer never waits: it writes the next
+ * slot in the ring even if the worker has fallen a whole ring behind, and
+ * the worker checks the slot's sequence number after copying it and tries
+ * again if the producer got there in the meantime. The worker only ever
+ * reads the newest slot, so anything older is simply counted as dropped.
+ */
+
+/*
+ * Waits to be woken for a new screen. With a marquee up, it moves it on
+ * every RENDER_MARQUEE_MS in the meantime, on monotonic deadlines so a
+ * wall clock change can't stall it. The fake clock only moves when the
+ * game sleeps, so there the marquee stays put instead.
+ */
+static void renderSleep (struct lcdRender *r)
+{
+  uint64_t due = deadlineAfterMs (RENDER_MARQUEE_MS) ;
+  struct timespec ts ;
+
+  for (;;)
+  {
+    if (!r->lcd->marqueeOn || timeIsFake ())
+    {
+      if (sem_wait (&r->wake) == 0)
+        return ;
+      continue ;
+    }
+
+    ts.tv_sec  = due / 1000000000ULL ;
+    ts.tv_nsec = due % 1000000000ULL ;
+    if (sem_clockwait (&r->wake, CLOCK_MONOTONIC, &ts) == 0)
+      return ;
+    if (errno == ETIMEDOUT)
+    {
+      lcdMarqueeStep (r->lcd) ;
+      due += RENDER_MARQUEE_MS * 1000000ULL ;
+    }
+  }
+}
+
+// Shows @text, as a marquee if a row doesn't fit
+static void renderDraw (struct lcdRender *r, char text [LCD_MAX_ROWS][LCD_LINE_LEN])
+{
+  struct lcdDataStruct *lcd = r->lcd ;
+  char lines [LCD_MAX_ROWS][LCD_LINE_LEN + 1] ;
+  int x, y, wide = 0 ;
+
+  for (y = 0 ; y < lcd->rows ; ++y)
+    for (x = lcd->cols ; x < LCD_LINE_LEN ; ++x)
+      wide |= text [y][x] != ' ' ;
+
+  if (!wide)
+  {
+    for (y = 0 ; y < LCD_MAX_ROWS ; ++y)
+      memcpy (lcd->frame [y], text [y], LCD_MAX_COLS) ;
+    lcdFlush (lcd) ;
+    return ;
+  }
+
+  memset (lines, 0, sizeof (lines)) ;
+  for (y = 0 ; y < LCD_MAX_ROWS ; ++y)
+    memcpy (lines [y], text [y], LCD_LINE_LEN) ;
+  lcdMarqueeStart (lcd, lines [0], lines [1]) ;
+}
+
+static void *renderThread (void *arg)
+{
+  struct lcdRender *r = arg ;
+  struct renderSlot *slot ;
+  char text [LCD_MAX_ROWS][LCD_LINE_LEN] ;
+  uint64_t seen = 0, t ;
+  uint32_t seq ;
+
+  for (;;)
+  {
+    renderSleep (r) ;
+    if (__atomic_load_n (&r->stop, __ATOMIC_ACQUIRE))
+      break ;
+
+    // Copy out the newest screen, again if the producer overwrote it meanwhile
+    do
+    {
+      t = __atomic_load_n (&r->tail, __ATOMIC_ACQUIRE) ;
+      if (t == seen)
+        break ;
+      slot = &r->ring [(t - 1) % RENDER_RING] ;
+      seq = __atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE) ;
+      if (seq & 1)
+        continue ;
+      memcpy (text, slot->text, sizeof (text)) ;
+      __atomic_thread_fence (__ATOMIC_ACQUIRE) ;
+    }
+    while ((seq & 1) || __atomic_load_n (&slot->seq, __ATOMIC_RELAXED) != seq) ;
+
+    if (t == seen)
+      continue ;
+
+    renderDraw (r, text) ;
+
+    __atomic_fetch_add (&r->frames, 1, __ATOMIC_RELAXED) ;
+    __atomic_fetch_add (&r->dropped, t - seen - 1, __ATOMIC_RELAXED) ;
+    seen = t ;
+
+    pthread_mutex_lock (&r->lock) ;
+    r->drawn = t ;
+    pthread_cond_broadcast (&r->done) ;
+    pthread_mutex_unlock (&r->lock) ;
+  }
+  return NULL ;
+}
+
+/*
+ * Hands @lcd over to a new render thread. Returns 0, or -1 if the thread
+ * can't be started.
+ */
+int lcdRenderStart (struct lcdRender *r, struct lcdDataStruct *lcd)
+{
+  memset (r, 0, sizeof (*r)) ;
+  r->lcd = lcd ;
+
+  if (sem_init (&r->wake, 0, 0) != 0)
+    return -1 ;
+  pthread_mutex_init (&r->lock, NULL) ;
+  pthread_cond_init  (&r->done, NULL) ;
+
+  if (pthread_create (&r->thread, NULL, renderThread, r) != 0)
+  {
+    sem_destroy (&r->wake) ;
+    return -1 ;
+  }
+  return 0 ;
+}
+
+/*
+ * Queues a screen with @top and @bottom, each padded with blanks, to
+ * replace whatever is showing. Rows longer than the display scroll.
+ * O(1), and never waits for the display.
+ */
+void lcdRenderSubmit (struct lcdRender *r, const char *top, const char *bottom)
+{
+  const char *lines [LCD_MAX_ROWS] = { top, bottom } ;
+  uint64_t t = r->tail ;
+  struct renderSlot *slot = &r->ring [t % RENDER_RING] ;
+  uint32_t seq = slot->seq ;
+  int y ;
+
+  __atomic_store_n (&slot->seq, seq + 1, __ATOMIC_RELAXED) ;
+  __atomic_thread_fence (__ATOMIC_RELEASE) ;
+
+  memset (slot->text, ' ', sizeof (slot->text)) ;
+  for (y = 0 ; y < LCD_MAX_ROWS ; ++y)
+    if (lines [y] != NULL)
+      memcpy (slot->text [y], lines [y], strnlen (lines [y], LCD_LINE_LEN)) ;
+
+  __atomic_store_n (&slot->seq, seq + 2, __ATOMIC_RELEASE) ;
+  __atomic_store_n (&r->tail, t + 1, __ATOMIC_RELEASE) ;
+  sem_post (&r->wake) ;
+}
+
+/*
+ * Blocks until the last screen submitted is on the display.
+ */
+void lcdRenderWait (struct lcdRender *r)
+{
+  uint64_t t = __atomic_load_n (&r->tail, __ATOMIC_RELAXED) ;
+
+  pthread_mutex_lock (&r->lock) ;
+  while (r->drawn < t)
+    pthread_cond_wait (&r->done, &r->lock) ;
+  pthread_mutex_unlock (&r->lock) ;
+}
+
+/*
+ * Stops the thread once it has finished the screen it is drawing; screens
+ * still queued are not drawn. The display belongs to the caller again.
+ */
+void lcdRenderStop (struct lcdRender *r)
+{
+  __atomic_store_n (&r->stop, 1, __ATOMIC_RELEASE) ;
+  sem_post (&r->wake) ;
+  pthread_join (r->thread, NULL) ;
+
+  pthread_cond_destroy  (&r->done) ;
+  pthread_mutex_destroy (&r->lock) ;
+  sem_destroy (&r->wake) ;
+}
@@ -0,0 +1,53 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "lcd.h"
+
+/*
+ * LCD render thread. The game submits whole screens and carries on; a
+ * worker thread owns the display and draws them with lcdFlush(). Screens
+ * go through a single-producer/single-consumer ring, and the worker always
+ * jumps to the newest one, so a screen that was replaced before it could
+ * be drawn is dropped rather than shown late.
+ *
+ * A screen with a row longer than the display (up to LCD_LINE_LEN) is
+ * shown as a marquee: written once, then scrolled by the controller one
+ * cell every RENDER_MARQUEE_MS until the next screen comes.
+ *
+ * Only one thread may submit, and nothing else may touch the display
+ * between lcdRenderStart() and lcdRenderStop().
+ */
+
+#define	RENDER_RING	8
+#define	RENDER_MARQUEE_MS	400
+
+struct renderSlot
+{
+  uint32_t seq ;			// odd while the producer is writing
+  char text [LCD_MAX_ROWS][LCD_LINE_LEN] ;
+} ;
+
+struct lcdRender
+{
+  struct lcdDataStruct *lcd ;
+  struct renderSlot ring [RENDER_RING] ;
+  uint64_t tail ;			// screens submitted, written by the producer
+  uint64_t drawn ;			// screens up to here are on the display
+  uint64_t frames, dropped ;		// stats: screens drawn and skipped
+  int stop ;
+  sem_t wake ;
+  pthread_mutex_t lock ;		// only for lcdRenderWait()
+  pthread_cond_t  done ;
+  pthread_t thread ;
+} ;
+
+int  lcdRenderStart  (struct lcdRender *r, struct lcdDataStruct *lcd) ;
+void lcdRenderSubmit (struct lcdRender *r, const char *top, const char *bottom) ;
+void lcdRenderWait   (struct lcdRender *r) ;
+void lcdRenderStop   (struct lcdRender *r) ;
+
+#endif
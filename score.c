@@ -0,0 +1,301 @@
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCORE_X86 1
+#endif
+
+#include "score.h"
+
+// Candidates are scored this many at a time when building a histogram
+#define SCORE_CHUNK 256
+
+/*
+ * Packs @length digits into one word, digit x going into nibble x. The caller
+ * is responsible for keeping length <= SCORE_MAX_LENGTH and every digit
+ * <= SCORE_MAX_RANGE; main() checks both before the game starts.
+ */
+uint64_t packCode(const int *digits, int length) {
+
+  uint64_t code = 0;
+  int x;
+
+  for(x = length - 1; x >= 0; x--) {
+    code = (code << 4) | (uint64_t)(digits[x] & 0xF);
+  }
+  return code;
+}
+
+/*
+ * Reverses packCode(), writing @length digits into the given array.
+ */
+void unpackCode(uint64_t code, int *digits, int length) {
+
+  int x;
+
+  for(x = 0; x < length; x++) {
+    digits[x] = (int)(code & 0xF);
+    code >>= 4;
+  }
+}
+
+/*
+ * Expands a packed code into one colour mask per position.
+ */
+void spreadCode(struct spreadCode *out, uint64_t code) {
+
+  int x;
+
+  for(x = 0; x < SCORE_MAX_LENGTH; x++) {
+    out->colours[x] = (code & 0xF) ? (uint16_t)(1u << (code & 0xF)) : 0;
+    code >>= 4;
+  }
+}
+
+/*
+ * Number of codes of the given shape, or -1 if it doesn't fit a long.
+ */
+long codeSpaceSize(int length, int numRange) {
+
+  long size = 1;
+  int x;
+
+  for(x = 0; x < length; x++) {
+    if(size > LONG_MAX / numRange) {
+      return -1;
+    }
+    size *= numRange;
+  }
+  return size;
+}
+
+/*
+ * Writes every code of the given shape into @codes, counting like an
+ * odometer with digit 0 turning fastest. Returns the number written.
+ */
+long enumerateCodes(int length, int numRange, uint64_t *codes) {
+
+  int digits[SCORE_MAX_LENGTH];
+  long count = 0;
+  int x;
+
+  for(x = 0; x < length; x++) {
+    digits[x] = 1;
+  }
+  for(;;) {
+    codes[count++] = packCode(digits, length);
+
+    for(x = 0; x < length && digits[x] == numRange; x++) {
+      digits[x] = 1;
+    }
+    if(x == length) {
+      return count;
+    }
+    digits[x]++;
+  }
+}
+
+/*
+ * Reverses feedbackCode().
+ */
+struct score feedbackScore(int feedback, int length) {
+
+  struct score s;
+
+  for(s.exact = 0; feedback > length - s.exact; s.exact++) {
+    feedback -= length - s.exact + 1;
+  }
+  s.near = feedback;
+  return s;
+}
+
+/* Batch kernels ------------------------------------------------------------------- */
+
+/*
+ * All kernels score the same way as scorePacked(): a position is exact when
+ * both colour masks share a bit, and near hits are the colours present in
+ * the non-exact positions of both codes.
+ */
+static void batchScalar(const struct spreadCode *guess, const struct spreadCode *candidates,
+    long count, int length, uint8_t *feedback) {
+
+  long i;
+  int x;
+
+  for(i = 0; i < count; i++) {
+    const uint16_t *c = candidates[i].colours;
+    unsigned guessSet = 0, candidateSet = 0;
+    struct score s = { 0, 0 };
+
+    for(x = 0; x < length; x++) {
+      if(guess->colours[x] & c[x]) {
+        s.exact++;
+      } else {
+        guessSet |= guess->colours[x];
+        candidateSet |= c[x];
+      }
+    }
+    s.near = __builtin_popcount(guessSet & candidateSet);
+    feedback[i] = (uint8_t)feedbackCode(s, length);
+  }
+}
+
+#ifdef SCORE_X86
+/*
+ * ORs the eight 16-bit lanes of v together.
+ */
+__attribute__((target("sse2")))
+static inline unsigned orLanes(__m128i v) {
+  v = _mm_or_si128(v, _mm_srli_si128(v, 8));
+  v = _mm_or_si128(v, _mm_srli_si128(v, 4));
+  v = _mm_or_si128(v, _mm_srli_si128(v, 2));
+  return (unsigned)_mm_cvtsi128_si32(v) & 0xFFFF;
+}
+
+__attribute__((target("sse2")))
+static void batchSse2(const struct spreadCode *guess, const struct spreadCode *candidates,
+    long count, int length, uint8_t *feedback) {
+
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i g0 = _mm_load_si128((const __m128i *)guess->colours);
+  const __m128i g1 = _mm_load_si128((const __m128i *)guess->colours + 1);
+  long i;
+
+  // Codes of up to 8 digits live entirely in the first register
+  if(length <= 8) {
+    for(i = 0; i < count; i++) {
+      __m128i s0 = _mm_load_si128((const __m128i *)candidates[i].colours);
+      __m128i m0 = _mm_cmpeq_epi16(_mm_and_si128(g0, s0), zero);
+      struct score s;
+
+      s.exact = __builtin_popcount(~(unsigned)_mm_movemask_epi8(m0) & 0xFFFF) / 2;
+      s.near = __builtin_popcount(orLanes(_mm_and_si128(g0, m0)) & orLanes(_mm_and_si128(s0, m0)));
+      feedback[i] = (uint8_t)feedbackCode(s, length);
+    }
+    return;
+  }
+  for(i = 0; i < count; i++) {
+    const __m128i *c = (const __m128i *)candidates[i].colours;
+    __m128i s0 = _mm_load_si128(c), s1 = _mm_load_si128(c + 1);
+    // All ones in every lane that is not an exact hit
+    __m128i m0 = _mm_cmpeq_epi16(_mm_and_si128(g0, s0), zero);
+    __m128i m1 = _mm_cmpeq_epi16(_mm_and_si128(g1, s1), zero);
+    unsigned open = (unsigned)_mm_movemask_epi8(m0) | (unsigned)_mm_movemask_epi8(m1) << 16;
+    unsigned guessSet = orLanes(_mm_or_si128(_mm_and_si128(g0, m0), _mm_and_si128(g1, m1)));
+    unsigned candidateSet = orLanes(_mm_or_si128(_mm_and_si128(s0, m0), _mm_and_si128(s1, m1)));
+    struct score s;
+
+    s.exact = __builtin_popcount(~open) / 2;
+    s.near = __builtin_popcount(guessSet & candidateSet);
+    feedback[i] = (uint8_t)feedbackCode(s, length);
+  }
+}
+
+__attribute__((target("avx2,popcnt")))
+static void batchAvx2(const struct spreadCode *guess, const struct spreadCode *candidates,
+    long count, int length, uint8_t *feedback) {
+
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i g = _mm256_load_si256((const __m256i *)guess->colours);
+  long i;
+
+  for(i = 0; i < count; i++) {
+    __m256i c = _mm256_load_si256((const __m256i *)candidates[i].colours);
+    __m256i m = _mm256_cmpeq_epi16(_mm256_and_si256(g, c), zero);
+    __m256i gx = _mm256_and_si256(g, m), cx = _mm256_and_si256(c, m);
+    // Fold both 256-bit sets down to 128 bits: guess in the low half, candidate in the high
+    __m256i folded = _mm256_or_si256(_mm256_permute2x128_si256(gx, cx, 0x20),
+                                     _mm256_permute2x128_si256(gx, cx, 0x31));
+    __m128i lo = _mm256_castsi256_si128(folded), hi = _mm256_extracti128_si256(folded, 1);
+    struct score s;
+
+    s.exact = __builtin_popcount(~(unsigned)_mm256_movemask_epi8(m)) / 2;
+    s.near = __builtin_popcount(orLanes(lo) & orLanes(hi));
+    feedback[i] = (uint8_t)feedbackCode(s, length);
+  }
+}
+#endif
+
+typedef void (*batchFn)(const struct spreadCode *, const struct spreadCode *, long, int, uint8_t *);
+
+static struct {
+  const char *name;
+  batchFn fn;
+} kernels[] = {
+#ifdef SCORE_X86
+  { "avx2", batchAvx2 },
+  { "sse2", batchSse2 },
+#endif
+  { "scalar", batchScalar },
+};
+
+static batchFn batchKernel;
+static const char *batchKernelName;
+
+/*
+ * Selects the batch kernel. A name forces that kernel (useful when
+ * benchmarking); NULL keeps the current one, picking the fastest the CPU
+ * supports if none has been chosen yet. Call it once before scoring from
+ * several threads. Returns the name of the kernel in use, or NULL if the
+ * named kernel doesn't exist or the CPU can't run it.
+ */
+const char *scoreKernel(const char *name) {
+
+  unsigned x;
+
+  if(name == NULL && batchKernel != NULL) {
+    return batchKernelName;
+  }
+  for(x = 0; x < sizeof(kernels) / sizeof(kernels[0]); x++) {
+#ifdef SCORE_X86
+    if(kernels[x].fn == batchAvx2 && !__builtin_cpu_supports("avx2")) {
+      continue;
+    }
+#endif
+    if(name == NULL || strcmp(name, kernels[x].name) == 0) {
+      batchKernel = kernels[x].fn;
+      batchKernelName = kernels[x].name;
+      return batchKernelName;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Scores @guess against @count spread candidates, writing one feedback code
+ * per candidate.
+ */
+void scoreBatch(uint64_t guess, const struct spreadCode *candidates, long count, int length, uint8_t *feedback) {
+
+  struct spreadCode g;
+
+  scoreKernel(NULL);
+  spreadCode(&g, guess);
+  batchKernel(&g, candidates, count, length, feedback);
+}
+
+/*
+ * Scores @guess against @count candidates and adds up how many fall into
+ * each feedback code. @histogram must hold SCORE_FEEDBACK_CODES(length)
+ * entries; it is cleared first.
+ */
+void scoreHistogram(uint64_t guess, const struct spreadCode *candidates, long count, int length, unsigned *histogram) {
+
+  uint8_t feedback[SCORE_CHUNK];
+  struct spreadCode g;
+  long i, j, n;
+
+  scoreKernel(NULL);
+  spreadCode(&g, guess);
+  memset(histogram, 0, SCORE_FEEDBACK_CODES(length) * sizeof(*histogram));
+
+  for(i = 0; i < count; i += n) {
+    n = (count - i < SCORE_CHUNK) ? count - i : SCORE_CHUNK;
+    batchKernel(&g, candidates + i, n, length, feedback);
+    for(j = 0; j < n; j++) {
+      histogram[feedback[j]]++;
+    }
+  }
+}
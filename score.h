@@ -0,0 +1,100 @@
+#ifndef SCORE_H
+#define SCORE_H
+
+#include <stdint.h>
+
+/*
+ * Packed scoring engine. A code of up to SCORE_MAX_LENGTH digits is packed
+ * into a single 64-bit word, one digit per nibble with digit 0 of the code in
+ * the lowest nibble. Digits run from 1 to SCORE_MAX_RANGE; a nibble of 0 means
+ * "no colour" (an unused position, or a digit the player never pressed).
+ */
+#define SCORE_MAX_LENGTH 16
+#define SCORE_MAX_RANGE  15
+
+#define SCORE_NIBBLE_LOW 0x1111111111111111ULL
+
+/*
+ * The result of scoring one guess against one secret. exact is the number of
+ * digits in the right place, near the number of colour-only hits.
+ */
+struct score {
+  int exact;
+  int near;
+};
+
+/*
+ * A code expanded to one 16-bit colour mask per position (bit c set for
+ * colour c, all zero for unused positions). 32 bytes, so a whole code fits
+ * one AVX2 register or two SSE2 registers. This is the candidate layout the
+ * batch scorer works on; build it once per code space with spreadCode().
+ */
+struct spreadCode {
+  uint16_t colours[SCORE_MAX_LENGTH];
+} __attribute__((aligned(32)));
+
+/*
+ * Every (exact, near) pair with exact + near <= length gets a small feedback
+ * code so a whole score fits a uint8_t, even for length 16.
+ */
+#define SCORE_FEEDBACK_CODES(length) ((((length) + 1) * ((length) + 2)) / 2)
+
+uint64_t packCode(const int *digits, int length);
+void unpackCode(uint64_t code, int *digits, int length);
+void spreadCode(struct spreadCode *out, uint64_t code);
+
+long codeSpaceSize(int length, int numRange);
+long enumerateCodes(int length, int numRange, uint64_t *codes);
+
+struct score feedbackScore(int feedback, int length);
+
+const char *scoreKernel(const char *name);
+void scoreBatch(uint64_t guess, const struct spreadCode *candidates, long count, int length, uint8_t *feedback);
+void scoreHistogram(uint64_t guess, const struct spreadCode *candidates, long count, int length, unsigned *histogram);
+
+/*
+ * Marks every non-zero nibble of x by setting the lowest bit of that nibble.
+ */
+static inline uint64_t nibbleMarkers(uint64_t x) {
+  return (x | x >> 1 | x >> 2 | x >> 3) & SCORE_NIBBLE_LOW;
+}
+
+/*
+ * Scores a packed guess against a packed secret. Exact hits are the nibbles
+ * that are equal and in use, counted with one popcount. For the remaining
+ * positions we build a 16-bit colour set for each side and intersect them:
+ * a colour scores one near hit if it is left over in both the guess and the
+ * secret, however many times it appears. This is the rule compare() has
+ * always applied, so results are identical to the original nested loops.
+ */
+static inline struct score scorePacked(uint64_t secret, uint64_t guess) {
+
+  struct score s;
+  uint64_t used = nibbleMarkers(secret);
+  uint64_t diff = nibbleMarkers(secret ^ guess);
+  uint64_t open = used & diff;
+  unsigned secretSet = 0, guessSet = 0;
+
+  s.exact = __builtin_popcountll(used & ~diff);
+
+  while (open) {
+    int shift = __builtin_ctzll(open);
+
+    secretSet |= 1u << ((secret >> shift) & 0xF);
+    guessSet  |= 1u << ((guess  >> shift) & 0xF);
+    open &= open - 1;
+  }
+  // Colour 0 never appears in a secret, so it can't leak into the result
+  s.near = __builtin_popcount(secretSet & guessSet);
+
+  return s;
+}
+
+/*
+ * Maps a score onto its feedback code, 0 .. SCORE_FEEDBACK_CODES(length)-1.
+ */
+static inline int feedbackCode(struct score s, int length) {
+  return s.exact * (2 * length + 3 - s.exact) / 2 + s.near;
+}
+
+#endif
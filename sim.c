@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "score.h"
+#include "game.h"
+
+/*
+ * Headless simulation: plays the game against every possible secret with
+ * an automatic player, with no GPIO, LCD or delays, and reports how fast
+ * and how well it went. Output is one "key: value" per line.
+ *
+ *   ./sim [strategy [length numRange]]
+ *
+ * Strategies: knuth (default), consistent.
+ */
+
+// A player that needs more guesses than this is counted as failed
+#define SIM_MAX_TRIES 64
+
+static double now(void) {
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+
+  const char *name = "knuth";
+  int length = 4, numRange = 6;
+  int histogram[SIM_MAX_TRIES + 1] = { 0 };
+  int secret[SCORE_MAX_LENGTH];
+  int maxTries = 0, failed = 0, x;
+  long count, i, total = 0;
+  uint64_t *codes;
+  struct strategy player;
+  struct game game;
+  double start, setup, elapsed;
+
+  if(argc >= 2) {
+    name = argv[1];
+  }
+  if(argc >= 4) {
+    length = atoi(argv[2]);
+    numRange = atoi(argv[3]);
+  }
+  if(length < 1 || length > SCORE_MAX_LENGTH || numRange < 1 || numRange > SCORE_MAX_RANGE) {
+    fprintf(stderr, "length must be 1-%d and numRange 1-%d\n", SCORE_MAX_LENGTH, SCORE_MAX_RANGE);
+    return 1;
+  }
+
+  count = codeSpaceSize(length, numRange);
+  codes = count > 0 ? malloc(count * sizeof(*codes)) : NULL;
+  if(codes == NULL) {
+    fprintf(stderr, "can't enumerate %d^%d codes\n", numRange, length);
+    return 1;
+  }
+  enumerateCodes(length, numRange, codes);
+
+  start = now();
+  if(strategyByName(&player, name, length, numRange) != 0) {
+    fprintf(stderr, "no strategy %s for %d^%d codes\n", name, numRange, length);
+    return 1;
+  }
+  setup = now() - start;
+
+  gameInit(&game, length, numRange);
+  start = now();
+  for(i = 0; i < count; i++) {
+    int tries;
+
+    unpackCode(codes[i], secret, length);
+    gameSetSecret(&game, secret);
+    tries = gamePlay(&game, &player, SIM_MAX_TRIES);
+
+    if(tries < 0) {
+      failed++;
+      continue;
+    }
+    histogram[tries]++;
+    total += tries;
+    if(tries > maxTries) {
+      maxTries = tries;
+    }
+  }
+  elapsed = now() - start;
+
+  printf("strategy: %s\n", player.name);
+  printf("length: %d\n", length);
+  printf("numRange: %d\n", numRange);
+  printf("games: %ld\n", count);
+  printf("failed: %d\n", failed);
+  printf("setup_ms: %.3f\n", setup * 1e3);
+  printf("play_ms: %.3f\n", elapsed * 1e3);
+  printf("games_per_second: %.0f\n", count / elapsed);
+  printf("mean_guesses: %.4f\n", count > failed ? (double)total / (count - failed) : 0.0);
+  printf("max_guesses: %d\n", maxTries);
+  printf("histogram:");
+  for(x = 1; x <= maxTries; x++) {
+    printf(" %d=%d", x, histogram[x]);
+  }
+  printf("\n");
+
+  strategyFree(&player);
+  free(codes);
+  return failed != 0;
+}
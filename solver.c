@@ -0,0 +1,383 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "score.h"
+#include "solver.h"
+
+/*
+ * Knuth's minimax solver. Every guess is the code whose worst-case answer
+ * leaves the fewest candidates; ties go to a code that could still be the
+ * secret, then to the lowest code index, so play is fully deterministic.
+ *
+ * The minimax step tries every code as a guess, which is O(N^2) for the
+ * first guess of an N-code space, so it runs on a work-stealing pool. Each
+ * worker keeps its own best guess and the results are merged with the same
+ * total order, so the answer never depends on the number of threads.
+ */
+
+// Roughly how many scores one pool task should cover
+#define SOLVER_TASK_SCORES 65536L
+
+/*
+ * The best guess one worker has seen. Padded to a cache line so workers
+ * don't share lines while they update their own entry.
+ */
+struct minimaxBest {
+  long guess, worst;
+  int isCandidate;
+} __attribute__((aligned(64)));
+
+struct minimaxJob {
+  struct solver *sv;
+  const long *candidates;
+  long n;
+  const struct spreadCode *packed;
+  struct minimaxBest *best;   // one per worker
+  long bound;                 // smallest worst case seen by any worker
+};
+
+
+static struct solverNode *newNode(int feedbacks) {
+
+  struct solverNode *node = malloc(sizeof(*node));
+
+  if(node == NULL) {
+    return NULL;
+  }
+  node->guess = -1;
+  node->next = calloc(feedbacks, sizeof(*node->next));
+  if(node->next == NULL) {
+    free(node);
+    return NULL;
+  }
+  return node;
+}
+
+static void freeNode(struct solverNode *node, int feedbacks) {
+
+  int x;
+
+  if(node == NULL) {
+    return;
+  }
+  for(x = 0; x < feedbacks; x++) {
+    freeNode(node->next[x], feedbacks);
+  }
+  free(node->next);
+  free(node);
+}
+
+/*
+ * Pool task: fills the feedback table rows of guesses [begin, end).
+ */
+static void tableRows(void *arg, long begin, long end, int worker) {
+
+  struct solver *sv = arg;
+  long g;
+
+  (void)worker;
+  for(g = begin; g < end; g++) {
+    scoreBatch(sv->codes[g], sv->spread, sv->count, sv->length, sv->table + g * sv->count);
+  }
+}
+
+/*
+ * Enumerates the code space and, if it is small enough, fills in the
+ * feedback table one guess row at a time with the batch scorer. Returns 0
+ * on success, -1 if the space is too large or memory runs out.
+ */
+int solverInit(struct solver *sv, int length, int numRange) {
+
+  long g;
+
+  memset(sv, 0, sizeof(*sv));
+  sv->length = length;
+  sv->numRange = numRange;
+  sv->feedbacks = SCORE_FEEDBACK_CODES(length);
+  sv->count = codeSpaceSize(length, numRange);
+
+  if(sv->count < 0 || sv->count > SOLVER_MAX_CODES) {
+    return -1;
+  }
+  sv->codes = malloc(sv->count * sizeof(*sv->codes));
+  sv->spread = aligned_alloc(32, sv->count * sizeof(*sv->spread));
+  sv->isCandidate = calloc(sv->count, 1);
+  sv->root = newNode(sv->feedbacks);
+  if(sv->codes == NULL || sv->spread == NULL || sv->isCandidate == NULL || sv->root == NULL) {
+    solverFree(sv);
+    return -1;
+  }
+
+  // Settle the batch kernel before several threads start using it
+  scoreKernel(NULL);
+  if(solverSetThreads(sv, poolDefaultThreads()) != 0) {
+    solverFree(sv);
+    return -1;
+  }
+  enumerateCodes(length, numRange, sv->codes);
+  for(g = 0; g < sv->count; g++) {
+    spreadCode(&sv->spread[g], sv->codes[g]);
+  }
+
+  if(sv->count <= SOLVER_TABLE_LIMIT) {
+    sv->table = malloc(sv->count * sv->count);
+    if(sv->table == NULL) {
+      solverFree(sv);
+      return -1;
+    }
+    poolRun(&sv->pool, sv->count, 1, tableRows, sv);
+  }
+  return 0;
+}
+
+/*
+ * Runs the minimax step on @threads threads (at least 1). Returns 0 on
+ * success, -1 if the pool can't be started.
+ */
+int solverSetThreads(struct solver *sv, int threads) {
+
+  if(sv->threads > 0) {
+    poolFree(&sv->pool);
+    sv->threads = 0;
+  }
+  if(poolInit(&sv->pool, threads) != 0) {
+    return -1;
+  }
+  sv->threads = sv->pool.threads;
+  return 0;
+}
+
+void solverFree(struct solver *sv) {
+  if(sv->threads > 0) {
+    poolFree(&sv->pool);
+  }
+  freeNode(sv->root, sv->feedbacks);
+  free(sv->codes);
+  free(sv->spread);
+  free(sv->table);
+  free(sv->isCandidate);
+  memset(sv, 0, sizeof(*sv));
+}
+
+/*
+ * Size of the largest partition guess @g splits the candidates into. Once
+ * it passes @limit the exact value no longer matters, so we stop early.
+ */
+static long worstCase(struct solver *sv, long g, const long *candidates, long n,
+    const struct spreadCode *packed, long limit) {
+
+  unsigned histogram[SCORE_FEEDBACK_CODES(SCORE_MAX_LENGTH)];
+  long worst = 0, i;
+  int x;
+
+  if(sv->table != NULL) {
+    const uint8_t *row = sv->table + g * sv->count;
+
+    memset(histogram, 0, sv->feedbacks * sizeof(*histogram));
+    for(i = 0; i < n; i++) {
+      long size = ++histogram[row[candidates[i]]];
+
+      if(size > worst) {
+        worst = size;
+        if(worst > limit) {
+          break;
+        }
+      }
+    }
+    return worst;
+  }
+
+  scoreHistogram(sv->codes[g], packed, n, sv->length, histogram);
+  for(x = 0; x < sv->feedbacks; x++) {
+    if(histogram[x] > worst) {
+      worst = histogram[x];
+    }
+  }
+  return worst;
+}
+
+/*
+ * True if (worst, isCandidate, guess) a beats b: a smaller worst case, then
+ * a guess that could be the secret, then the lower code index.
+ */
+static int betterGuess(long worst, int isCandidate, long guess, const struct minimaxBest *b) {
+  if(worst != b->worst) {
+    return worst < b->worst;
+  }
+  if(isCandidate != b->isCandidate) {
+    return isCandidate;
+  }
+  return guess < b->guess;
+}
+
+/*
+ * Pool task: tries guesses [begin, end) and keeps the worker's best.
+ */
+static void minimaxRange(void *arg, long begin, long end, int worker) {
+
+  struct minimaxJob *job = arg;
+  struct solver *sv = job->sv;
+  struct minimaxBest *best = &job->best[worker];
+  long g;
+
+  for(g = begin; g < end; g++) {
+    int isCandidate = sv->isCandidate[g];
+    // g may tie our best so far only if it would win the tie
+    long limit = betterGuess(best->worst, isCandidate, g, best) ? best->worst : best->worst - 1;
+    long bound = __atomic_load_n(&job->bound, __ATOMIC_RELAXED);
+    long worst;
+
+    // Nothing worse than another worker's best can win either
+    if(bound < limit) {
+      limit = bound;
+    }
+    worst = worstCase(sv, g, job->candidates, job->n, job->packed, limit);
+
+    // Past the limit the count may be partial, so never record it
+    if(worst <= limit && betterGuess(worst, isCandidate, g, best)) {
+      best->guess = g;
+      best->worst = worst;
+      best->isCandidate = isCandidate;
+      while(worst < bound && !__atomic_compare_exchange_n(&job->bound, &bound, worst, 0,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      }
+    }
+  }
+}
+
+/*
+ * The minimax step: tries every code as the next guess against the @n
+ * remaining candidates and returns the index of the best one.
+ */
+long solverMinimax(struct solver *sv, const long *candidates, long n) {
+
+  struct minimaxJob job;
+  long i, grain, guess;
+  int x;
+
+  if(n <= 2) {
+    return candidates[0];
+  }
+
+  job.sv = sv;
+  job.candidates = candidates;
+  job.n = n;
+  job.packed = NULL;
+  job.bound = LONG_MAX;
+  job.best = aligned_alloc(64, sv->threads * sizeof(*job.best));
+  if(job.best == NULL) {
+    return candidates[0];
+  }
+  for(x = 0; x < sv->threads; x++) {
+    job.best[x].guess = LONG_MAX;
+    job.best[x].worst = LONG_MAX;
+    job.best[x].isCandidate = 0;
+  }
+
+  // Without a table, score against a compact copy of the candidates
+  if(sv->table == NULL) {
+    struct spreadCode *packed = aligned_alloc(32, n * sizeof(*packed));
+
+    if(packed == NULL) {
+      free(job.best);
+      return candidates[0];
+    }
+    for(i = 0; i < n; i++) {
+      packed[i] = sv->spread[candidates[i]];
+    }
+    job.packed = packed;
+  }
+  for(i = 0; i < n; i++) {
+    sv->isCandidate[candidates[i]] = 1;
+  }
+
+  grain = SOLVER_TASK_SCORES / n;
+  poolRun(&sv->pool, sv->count, grain, minimaxRange, &job);
+
+  for(x = 1; x < sv->threads; x++) {
+    if(betterGuess(job.best[x].worst, job.best[x].isCandidate, job.best[x].guess, &job.best[0])) {
+      job.best[0] = job.best[x];
+    }
+  }
+  for(i = 0; i < n; i++) {
+    sv->isCandidate[candidates[i]] = 0;
+  }
+  guess = job.best[0].guess;
+  free((void *)job.packed);
+  free(job.best);
+  return guess;
+}
+
+/*
+ * Starts a game: every code is a candidate and the next guess comes from
+ * the root of the decision tree.
+ */
+int solverStart(struct solver *sv, struct solverGame *game) {
+
+  long i;
+
+  game->solver = sv;
+  game->node = sv->root;
+  game->remaining = sv->count;
+  game->candidates = malloc(sv->count * sizeof(*game->candidates));
+  if(game->candidates == NULL) {
+    return -1;
+  }
+  for(i = 0; i < sv->count; i++) {
+    game->candidates[i] = i;
+  }
+  return 0;
+}
+
+/*
+ * Returns the next code to guess. The minimax step only runs the first
+ * time any game reaches this point of the tree.
+ */
+uint64_t solverNext(struct solverGame *game) {
+
+  struct solver *sv = game->solver;
+
+  if(game->node->guess < 0) {
+    game->node->guess = solverMinimax(sv, game->candidates, game->remaining);
+  }
+  return sv->codes[game->node->guess];
+}
+
+/*
+ * Takes the answer to the last guess from solverNext(), drops every
+ * candidate that would have answered differently and moves down the tree.
+ * Returns -1 if the next tree node can't be allocated.
+ */
+int solverFeedback(struct solverGame *game, struct score s) {
+
+  struct solver *sv = game->solver;
+  long g = game->node->guess, i, kept = 0;
+  int fb = feedbackCode(s, sv->length);
+
+  for(i = 0; i < game->remaining; i++) {
+    long c = game->candidates[i];
+    int answer = sv->table != NULL ? sv->table[g * sv->count + c]
+               : feedbackCode(scorePacked(sv->codes[c], sv->codes[g]), sv->length);
+
+    if(answer == fb) {
+      game->candidates[kept++] = c;
+    }
+  }
+  game->remaining = kept;
+
+  if(game->node->next[fb] == NULL) {
+    game->node->next[fb] = newNode(sv->feedbacks);
+    if(game->node->next[fb] == NULL) {
+      return -1;
+    }
+  }
+  game->node = game->node->next[fb];
+  return 0;
+}
+
+void solverEnd(struct solverGame *game) {
+  free(game->candidates);
+  game->candidates = NULL;
+}
@@ -0,0 +1,62 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stdint.h>
+
+#include "score.h"
+#include "pool.h"
+
+/*
+ * Code spaces up to this size get a full guess x secret feedback table
+ * (one byte per pair, 16MB at the limit). Larger ones score each guess on
+ * the fly with scoreHistogram().
+ */
+#define SOLVER_TABLE_LIMIT 4096L
+// Largest code space the solver will enumerate at all
+#define SOLVER_MAX_CODES   (1L << 22)
+
+/*
+ * One decision in Knuth's strategy. Which guess to make depends only on the
+ * feedback received so far, so the decisions form a tree that is shared by
+ * every game played with the same solver and built as games reach it.
+ */
+struct solverNode {
+  long guess;
+  struct solverNode **next;   // one child per feedback code, NULL until reached
+};
+
+struct solver {
+  int length, numRange;
+  int feedbacks;              // SCORE_FEEDBACK_CODES(length)
+  long count;                 // numRange^length codes
+  uint64_t *codes;            // every code, see enumerateCodes()
+  struct spreadCode *spread;  // the same codes laid out for scoreBatch()
+  uint8_t *table;             // table[guess * count + secret], or NULL
+  uint8_t *isCandidate;       // scratch flags for the minimax step
+  struct solverNode *root;
+  struct pool pool;           // runs the minimax step and table build
+  int threads;                // 0 until the pool is running
+};
+
+/*
+ * The state of one game: the codes still consistent with every answer so
+ * far, and the decision node the next guess comes from.
+ */
+struct solverGame {
+  struct solver *solver;
+  struct solverNode *node;
+  long *candidates;
+  long remaining;
+};
+
+int solverInit(struct solver *sv, int length, int numRange);
+void solverFree(struct solver *sv);
+int solverSetThreads(struct solver *sv, int threads);
+long solverMinimax(struct solver *sv, const long *candidates, long n);
+
+int solverStart(struct solver *sv, struct solverGame *game);
+uint64_t solverNext(struct solverGame *game);
+int solverFeedback(struct solverGame *game, struct score s);
+void solverEnd(struct solverGame *game);
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "score.h"
+#include "solver.h"
+
+/*
+ * Times the solver's first minimax step (every code against every code)
+ * single-threaded and on all cores, and checks that both pick the same
+ * guess.
+ *
+ *   ./solverbench [length numRange [threads]]
+ */
+
+static double now(void) {
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double timeMinimax(struct solver *sv, const long *all, long *guess) {
+
+  double start = now();
+
+  *guess = solverMinimax(sv, all, sv->count);
+  return now() - start;
+}
+
+int main(int argc, char **argv) {
+
+  int length = 4, numRange = 6, threads = 0;
+  struct solver sv;
+  double start, init, single, multi;
+  long *all, guessSingle, guessMulti, i;
+  int digits[SCORE_MAX_LENGTH], x;
+
+  if(argc >= 3) {
+    length = atoi(argv[1]);
+    numRange = atoi(argv[2]);
+  }
+  if(argc >= 4) {
+    threads = atoi(argv[3]);
+  }
+  if(length < 1 || length > SCORE_MAX_LENGTH || numRange < 1 || numRange > SCORE_MAX_RANGE) {
+    fprintf(stderr, "length must be 1-%d and numRange 1-%d\n", SCORE_MAX_LENGTH, SCORE_MAX_RANGE);
+    return 1;
+  }
+
+  start = now();
+  if(solverInit(&sv, length, numRange) != 0) {
+    fprintf(stderr, "solver can't handle %d^%d codes\n", numRange, length);
+    return 1;
+  }
+  init = now() - start;
+  if(threads > 0 && solverSetThreads(&sv, threads) != 0) {
+    fprintf(stderr, "can't start %d threads\n", threads);
+    return 1;
+  }
+  threads = sv.threads;
+
+  all = malloc(sv.count * sizeof(*all));
+  if(all == NULL) {
+    return 1;
+  }
+  for(i = 0; i < sv.count; i++) {
+    all[i] = i;
+  }
+
+  multi = timeMinimax(&sv, all, &guessMulti);
+  solverSetThreads(&sv, 1);
+  single = timeMinimax(&sv, all, &guessSingle);
+
+  printf("codes: %ld\n", sv.count);
+  printf("kernel: %s\n", scoreKernel(NULL));
+  printf("table: %s\n", sv.table != NULL ? "yes" : "no");
+  printf("init_ms: %.3f\n", init * 1e3);
+  printf("threads: %d\n", threads);
+  printf("minimax_1_ms: %.3f\n", single * 1e3);
+  printf("minimax_%d_ms: %.3f\n", threads, multi * 1e3);
+  printf("speedup: %.2f\n", single / multi);
+
+  unpackCode(sv.codes[guessMulti], digits, length);
+  printf("first_guess:");
+  for(x = 0; x < length; x++) {
+    printf(" %d", digits[x]);
+  }
+  printf("\n");
+
+  free(all);
+  solverFree(&sv);
+
+  if(guessSingle != guessMulti) {
+    fprintf(stderr, "guess differs between 1 and %d threads\n", threads);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,187 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "score.h"
+#include "solver.h"
+#include "game.h"
+
+/*
+ * Automatic players for the strategy interface in game.h.
+ */
+
+/* Knuth ---------------------------------------------------------------------------- */
+
+/*
+ * Plays Knuth's minimax strategy with the solver. The solver, its feedback
+ * table and its decision tree are shared by every game this player plays.
+ */
+struct knuthPlayer {
+  struct solver solver;
+  struct solverGame game;
+  int length;
+};
+
+static int knuthStart(void *state) {
+  struct knuthPlayer *p = state;
+  return solverStart(&p->solver, &p->game);
+}
+
+static void knuthNext(void *state, int *guess) {
+  struct knuthPlayer *p = state;
+  unpackCode(solverNext(&p->game), guess, p->length);
+}
+
+static void knuthFeedback(void *state, struct score s) {
+  struct knuthPlayer *p = state;
+  solverFeedback(&p->game, s);
+}
+
+static void knuthEnd(void *state) {
+  struct knuthPlayer *p = state;
+  solverEnd(&p->game);
+}
+
+static void knuthFree(void *state) {
+  struct knuthPlayer *p = state;
+  solverFree(&p->solver);
+  free(p);
+}
+
+int strategyKnuth(struct strategy *player, int length, int numRange) {
+
+  struct knuthPlayer *p = malloc(sizeof(*p));
+
+  if(p == NULL) {
+    return -1;
+  }
+  if(solverInit(&p->solver, length, numRange) != 0) {
+    free(p);
+    return -1;
+  }
+  p->length = length;
+
+  player->name = "knuth";
+  player->state = p;
+  player->start = knuthStart;
+  player->next = knuthNext;
+  player->feedback = knuthFeedback;
+  player->end = knuthEnd;
+  player->free = knuthFree;
+  return 0;
+}
+
+/* Consistent ----------------------------------------------------------------------- */
+
+/*
+ * Always guesses the first code (in enumerateCodes() order) that agrees
+ * with every answer so far. No lookahead, so it is a cheap baseline for
+ * comparing strategies against.
+ */
+struct consistentPlayer {
+  uint64_t *codes;
+  long count;
+  long *candidates;
+  long remaining;
+  uint64_t last;
+  int length;
+};
+
+static int consistentStart(void *state) {
+
+  struct consistentPlayer *p = state;
+  long i;
+
+  for(i = 0; i < p->count; i++) {
+    p->candidates[i] = i;
+  }
+  p->remaining = p->count;
+  return 0;
+}
+
+static void consistentNext(void *state, int *guess) {
+
+  struct consistentPlayer *p = state;
+
+  // An empty set means the answers were inconsistent; keep guessing something
+  p->last = p->codes[p->remaining > 0 ? p->candidates[0] : 0];
+  unpackCode(p->last, guess, p->length);
+}
+
+static void consistentFeedback(void *state, struct score s) {
+
+  struct consistentPlayer *p = state;
+  long i, kept = 0;
+
+  for(i = 0; i < p->remaining; i++) {
+    struct score t = scorePacked(p->codes[p->candidates[i]], p->last);
+
+    if(t.exact == s.exact && t.near == s.near) {
+      p->candidates[kept++] = p->candidates[i];
+    }
+  }
+  p->remaining = kept;
+}
+
+static void consistentEnd(void *state) {
+  (void)state;
+}
+
+static void consistentFree(void *state) {
+  struct consistentPlayer *p = state;
+  free(p->codes);
+  free(p->candidates);
+  free(p);
+}
+
+int strategyConsistent(struct strategy *player, int length, int numRange) {
+
+  struct consistentPlayer *p = calloc(1, sizeof(*p));
+
+  if(p == NULL) {
+    return -1;
+  }
+  p->length = length;
+  p->count = codeSpaceSize(length, numRange);
+  if(p->count < 0 || p->count > SOLVER_MAX_CODES) {
+    free(p);
+    return -1;
+  }
+  p->codes = malloc(p->count * sizeof(*p->codes));
+  p->candidates = malloc(p->count * sizeof(*p->candidates));
+  if(p->codes == NULL || p->candidates == NULL) {
+    consistentFree(p);
+    return -1;
+  }
+  enumerateCodes(length, numRange, p->codes);
+
+  player->name = "consistent";
+  player->state = p;
+  player->start = consistentStart;
+  player->next = consistentNext;
+  player->feedback = consistentFeedback;
+  player->end = consistentEnd;
+  player->free = consistentFree;
+  return 0;
+}
+
+/* ---------------------------------------------------------------------------------- */
+
+/*
+ * Creates the named player. Returns -1 for an unknown name or if the
+ * player can't handle a code space this large.
+ */
+int strategyByName(struct strategy *player, const char *name, int length, int numRange) {
+  if(strcmp(name, "knuth") == 0) {
+    return strategyKnuth(player, length, numRange);
+  }
+  if(strcmp(name, "consistent") == 0) {
+    return strategyConsistent(player, length, numRange);
+  }
+  return -1;
+}
+
+void strategyFree(struct strategy *player) {
+  if(player->free != NULL) {
+    player->free(player->state);
+  }
+}
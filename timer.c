@@ -16,6 +16,10 @@
 #include <sys/wait.h>
 #include <sys/ioctl.h>
 
+#include "gpio.h"
+#include "timing.h"
+#include "lcd.h"
+
 // original code based in wiringPi library by Gordon Henderson
 // #include "wiringPi.h"
 
@@ -34,23 +38,6 @@
 #define	FALSE	(1==2)
 #endif
 
-#define	PAGE_SIZE		(4*1024)
-#define	BLOCK_SIZE		(4*1024)
-
-#define	INPUT			 0
-#define	OUTPUT			 1
-
-#define	LOW			 0
-#define	HIGH			 1
-
-static volatile unsigned int gpiobase ;
-static volatile uint32_t *gpio ;
-
-
-// Mask for the bottom 64 pins which belong to the Raspberry Pi
-//	The others are available for the other devices
-
-#define	PI_GPIO_MASK	(0xFFFFFFC0)
 
 /* ------------------------------------------------------- */
 #define STRB_PIN 24
@@ -88,57 +75,13 @@ static unsigned char hawoNewChar [8] =
   0b11111,
 } ;
 
-// data structure holding data on the representation of the LCD
-struct lcdDataStruct
-{
-  int bits, rows, cols ;
-  int rsPin, strbPin ;
-  int dataPins [8] ;
-  int cx, cy ;
-} ;
-
-static int lcdControl ;
-
-/* ***************************************************************************** */
-/* INLINED fcts from wiringPi/devLib/lcd.c: */
-// HD44780U Commands (see Fig 11, p28 of the Hitachi HD44780U datasheet)
-
-#define	LCD_CLEAR	0x01
-#define	LCD_HOME	0x02
-#define	LCD_ENTRY	0x04
-#define	LCD_CTRL	0x08
-#define	LCD_CDSHIFT	0x10
-#define	LCD_FUNC	0x20
-#define	LCD_CGRAM	0x40
-#define	LCD_DGRAM	0x80
-
-// Bits in the entry register
-
-#define	LCD_ENTRY_SH		0x01
-#define	LCD_ENTRY_ID		0x02
-
-// Bits in the control register
-
-#define	LCD_BLINK_CTRL		0x01
-#define	LCD_CURSOR_CTRL		0x02
-#define	LCD_DISPLAY_CTRL	0x04
-
-// Bits in the function register
-
-#define	LCD_FUNC_F	0x04
-#define	LCD_FUNC_N	0x08
-#define	LCD_FUNC_DL	0x10
-
-#define	LCD_CDSHIFT_RL	0x04
-
 int failure (int fatal, const char *message, ...);
 void waitForEnter (void);
 
 /* ------------------------------------------------------- */
 /* low-level interface to the hardware */
 
-/* digitalWrite is now in a separate file: lcdBinary.c */
-void digitalWrite (uint32_t *gpio, int pin, int value);
+/* pinMode, digitalWrite and readPin are in gpio.c, the LCD driver is in lcd.c */
 
 void waitForEnter (void)
 {
@@ -147,347 +90,44 @@ void waitForEnter (void)
 }
 
 
-void strobe (const struct lcdDataStruct *lcd)
-{
-
-  // Note timing changes for new version of delayMicroseconds ()
-  digitalWrite (gpio, lcd->strbPin, 1) ; delayMicroseconds (50) ;
-  digitalWrite (gpio, lcd->strbPin, 0) ; delayMicroseconds (50) ;
-}
-
-/*
- * sentDataCmd:
- *	Send an data or command byte to the display.
- *********************************************************************************
- */
-
-void sendDataCmd (const struct lcdDataStruct *lcd, unsigned char data)
-{
-  register unsigned char myData = data ;
-  unsigned char          i, d4 ;
-
-  if (lcd->bits == 4)
-  {
-    d4 = (myData >> 4) & 0x0F;
-    for (i = 0 ; i < 4 ; ++i)
-    {
-      digitalWrite (gpio, lcd->dataPins [i], (d4 & 1)) ;
-      d4 >>= 1 ;
-    }
-    strobe (lcd) ;
-
-    d4 = myData & 0x0F ;
-    for (i = 0 ; i < 4 ; ++i)
-    {
-      digitalWrite (gpio, lcd->dataPins [i], (d4 & 1)) ;
-      d4 >>= 1 ;
-    }
-  }
-  else
-  {
-    for (i = 0 ; i < 8 ; ++i)
-    {
-      digitalWrite (gpio, lcd->dataPins [i], (myData & 1)) ;
-      myData >>= 1 ;
-    }
-  }
-  strobe (lcd) ;
-}
-
-/*
- * lcdPutCommand:
- *	Send a command byte to the display
- *********************************************************************************
- */
-
-void lcdPutCommand (const struct lcdDataStruct *lcd, unsigned char command)
-{
-#ifdef DEBUG
- // fprintf(stderr, "lcdPutCommand: digitalWrite(%d,%d) and sendDataCmd(%d,%d)\n", lcd->rsPin,   0, lcd, command);
-#endif
-  digitalWrite (gpio, lcd->rsPin,   0) ;
-  sendDataCmd  (lcd, command) ;
-  delay (2) ;
-}
-
-void lcdPut4Command (const struct lcdDataStruct *lcd, unsigned char command)
-{
-  register unsigned char myCommand = command ;
-  register unsigned char i ;
-
-  digitalWrite (gpio, lcd->rsPin,   0) ;
-
-  for (i = 0 ; i < 4 ; ++i)
-  {
-    digitalWrite (gpio, lcd->dataPins [i], (myCommand & 1)) ;
-    myCommand >>= 1 ;
-  }
-  strobe (lcd) ;
-}
-
-/*
- * lcdHome: lcdClear:
- *	Home the cursor or clear the screen.
- *********************************************************************************
- */
-
-void lcdHome (struct lcdDataStruct *lcd)
-{
-#ifdef DEBUG
-  //f(stderr, "lcdHome: lcdPutCommand(%d,%d)\n", lcd, LCD_HOME);
-#endif
-  lcdPutCommand (lcd, LCD_HOME) ;
-  lcd->cx = lcd->cy = 0 ;
-  delay (5) ;
-}
-
-void lcdClear (struct lcdDataStruct *lcd)
-{
-#ifdef DEBUG
- // fprintf(stderr, "lcdClear: lcdPutCommand(%d,%d) and lcdPutCommand(%d,%d)\n", lcd, LCD_CLEAR, lcd, LCD_HOME);
-#endif
-  lcdPutCommand (lcd, LCD_CLEAR) ;
-  lcdPutCommand (lcd, LCD_HOME) ;
-  lcd->cx = lcd->cy = 0 ;
-  delay (5) ;
-}
-
-/*
- * lcdPosition:
- *	Update the position of the cursor on the display.
- *	Ignore invalid locations.
- *********************************************************************************
- */
-
-void lcdPosition (struct lcdDataStruct *lcd, int x, int y)
-{
-  // struct lcdDataStruct *lcd = lcds [fd] ;
-
-  if ((x > lcd->cols) || (x < 0))
-    return ;
-  if ((y > lcd->rows) || (y < 0))
-    return ;
-
-  lcdPutCommand (lcd, x + (LCD_DGRAM | (y>0 ? 0x40 : 0x00)  /* rowOff [y] */  )) ;
-
-  lcd->cx = x ;
-  lcd->cy = y ;
-}
-
-
-void delayMicroseconds (unsigned int howLong)
-{
-  struct timespec sleeper ;
-  unsigned int uSecs = howLong % 1000000 ;
-  unsigned int wSecs = howLong / 1000000 ;
-
-  /**/ if (howLong ==   0)
-    return ;
-#if 0
-  else if (howLong  < 100)
-    delayMicrosecondsHard (howLong) ;
-#endif
-  else
-  {
-    sleeper.tv_sec  = wSecs ;
-    sleeper.tv_nsec = (long)(uSecs * 1000L) ;
-    nanosleep (&sleeper, NULL) ;
-  }
-}
-
-/*
- * lcdDisplay: lcdCursor: lcdCursorBlink:
- *	Turn the display, cursor, cursor blinking on/off
- *********************************************************************************
- */
-
-void lcdDisplay (struct lcdDataStruct *lcd, int state)
-{
-  if (state)
-    lcdControl |=  LCD_DISPLAY_CTRL ;
-  else
-    lcdControl &= ~LCD_DISPLAY_CTRL ;
-
-  lcdPutCommand (lcd, LCD_CTRL | lcdControl) ; 
-}
-
-void lcdCursor (struct lcdDataStruct *lcd, int state)
-{
-  if (state)
-    lcdControl |=  LCD_CURSOR_CTRL ;
-  else
-    lcdControl &= ~LCD_CURSOR_CTRL ;
-
-  lcdPutCommand (lcd, LCD_CTRL | lcdControl) ; 
-}
-
-void lcdCursorBlink (struct lcdDataStruct *lcd, int state)
-{
-  if (state)
-    lcdControl |=  LCD_BLINK_CTRL ;
-  else
-    lcdControl &= ~LCD_BLINK_CTRL ;
-
-  lcdPutCommand (lcd, LCD_CTRL | lcdControl) ; 
-}
-
-/*
- * lcdPutchar:
- *	Send a data byte to be displayed on the display. We implement a very
- *	simple terminal here - with line wrapping, but no scrolling. Yet.
- *********************************************************************************
- */
-
-void lcdPutchar (struct lcdDataStruct *lcd, unsigned char data)
-{
-  digitalWrite (gpio, lcd->rsPin, 1) ;
-  sendDataCmd  (lcd, data) ;
+/* ----------------------------------------------------------------------------- */
 
-  if (++lcd->cx == lcd->cols)
-  {
-    lcd->cx = 0 ;
-    if (++lcd->cy == lcd->rows)
-      lcd->cy = 0 ;
-    
-    // TODO: inline computation of address and eliminate rowOff
-    lcdPutCommand (lcd, lcd->cx + (LCD_DGRAM | (lcd->cy>0 ? 0x40 : 0x00)   /* rowOff [lcd->cy] */  )) ;
-  }
-}
 /*
- * lcdPuts:
- *	Send a string to be displayed on the display
- *********************************************************************************
+ * The display is set up on the first call and kept for the whole run;
+ * after that a call only sends the characters that changed.
  */
-void lcdPuts (struct lcdDataStruct *lcd, const char *string)
-{
-  while (*string)
-    lcdPutchar (lcd, *string++) ;
-}
+static struct lcdDataStruct *lcd ;
 
-/* ----------------------------------------------------------------------------- */
+#define MARQUEE_MS 300
 
 int LCDmain (char *string, char *string2)
 {
-  int i ;
-  struct lcdDataStruct *lcd ;
-  int bits, rows, cols ;
-  unsigned char func ;
-
-  struct tm *t ;
-  time_t tim ;
-
-  int   fd ;
-
-  char buf [32] ;
-
-  // hard-coded: 16x2 display, using a 4-bit connection
-  bits = 4; 
-  cols = 16; 
-  rows = 2; 
-
-  //printf ("Raspberry Pi LCD driver, for a %dx%d display (%d-bit wiring) \n", cols, rows, bits) ;
-
-  if (geteuid () != 0)
-    fprintf (stderr, "setup: Must be root. (Did you forget sudo?)\n") ;
-
-  // -----------------------------------------------------------------------------
-  // constants for RPi2
-  gpiobase = 0x3F200000 ;
-
-  // -----------------------------------------------------------------------------
-  // memory mapping 
-  // Open the master /dev/memory device
-
-  if ((fd = open ("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC) ) < 0)
-    return failure (FALSE, "setup: Unable to open /dev/mem: %s\n", strerror (errno)) ;
-
-  // GPIO:
-  gpio = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, gpiobase) ;
-  if ((int32_t)gpio == -1)
-    return failure (FALSE, "setup: mmap (GPIO) failed: %s\n", strerror (errno)) ;
-
-  // ------
-  // INLINED version of hawoLcdInit (can only deal with one LCD attached to the RPi):
-  // Create a new LCD:
-  lcd = (struct lcdDataStruct *)malloc (sizeof (struct lcdDataStruct)) ;
   if (lcd == NULL)
-    return -1 ;
-
-  // hard-wired GPIO pins
-  lcd->rsPin   = RS_PIN ;
-  lcd->strbPin = STRB_PIN ;
-  lcd->bits    = 4 ;
-  lcd->rows    = rows ;  // # of rows on the display
-  lcd->cols    = cols ;  // # of cols on the display
-  lcd->cx      = 0 ;     // x-pos of cursor
-  lcd->cy      = 0 ;     // y-pos of curosr
-
-  lcd->dataPins [0] = DATA0_PIN ;
-  lcd->dataPins [1] = DATA1_PIN ;
-  lcd->dataPins [2] = DATA2_PIN ;
-  lcd->dataPins [3] = DATA3_PIN ;
-  // lcd->dataPins [4] = d4 ;
-  // lcd->dataPins [5] = d5 ;
-  // lcd->dataPins [6] = d6 ;
-  // lcd->dataPins [7] = d7 ;
-
-  // lcds [lcdFd] = lcd ;
-
-  digitalWrite (gpio, lcd->rsPin,   0) ; pinMode (gpio, lcd->rsPin,   OUTPUT) ;
-  digitalWrite (gpio, lcd->strbPin, 0) ; pinMode (gpio, lcd->strbPin, OUTPUT) ;
-
-  for (i = 0 ; i < bits ; ++i)
   {
-    digitalWrite (gpio, lcd->dataPins [i], 0) ;
-    pinMode      (gpio, lcd->dataPins [i], OUTPUT) ;
+    // Real registers via /dev/mem on the Pi, or the simulated register file
+    if (gpioSetup (NULL) != 0)
+      return failure (FALSE, "setup: Unable to open GPIO (%s): %s\n", gpioBackendName (), strerror (errno)) ;
+
+    // hard-coded: 16x2 display, using a 4-bit connection
+    lcd = lcdInit (2, 16, 4, RS_PIN, STRB_PIN, DATA0_PIN, DATA1_PIN, DATA2_PIN, DATA3_PIN) ;
+    if (lcd == NULL)
+      return failure (FALSE, "setup: Unable to initialise the LCD\n") ;
   }
-  delay (35) ; // mS
 
-  if (bits == 4)
-  {
-    func = LCD_FUNC | LCD_FUNC_DL ;			// Set 8-bit mode 3 times
-    lcdPut4Command (lcd, func >> 4) ; delay (35) ;
-    lcdPut4Command (lcd, func >> 4) ; delay (35) ;
-    lcdPut4Command (lcd, func >> 4) ; delay (35) ;
-    func = LCD_FUNC ;					// 4th set: 4-bit mode
-    lcdPut4Command (lcd, func >> 4) ; delay (35) ;
-    lcd->bits = 4 ;
-  }
-  else
+  // A longer message scrolls until its end is in view
+  if ((strlen (string) > LCD_MAX_COLS) || (strlen (string2) > LCD_MAX_COLS))
   {
-    failure(TRUE, "setup: only 4-bit connection supported\n");
-    func = LCD_FUNC | LCD_FUNC_DL ;
-    lcdPutCommand  (lcd, func     ) ; delay (35) ;
-    lcdPutCommand  (lcd, func     ) ; delay (35) ;
-    lcdPutCommand  (lcd, func     ) ; delay (35) ;
-  }
+    int i, n = lcdMarqueeStart (lcd, string, string2) ;
 
-  if (lcd->rows > 1)
-  {
-    func |= LCD_FUNC_N ;
-    lcdPutCommand (lcd, func) ; delay (35) ;
+    for (i = LCD_MAX_COLS ; i < n ; ++i)
+    {
+      delay (MARQUEE_MS) ;
+      lcdMarqueeStep (lcd) ;
+    }
+    return 0 ;
   }
 
-  // Rest of the initialisation sequence
-  lcdDisplay     (lcd, TRUE) ;
-  lcdCursor      (lcd, FALSE) ;
-  lcdCursorBlink (lcd, FALSE) ;
-  lcdClear       (lcd) ;
-
-  lcdPutCommand (lcd, LCD_ENTRY   | LCD_ENTRY_ID) ;    // set entry mode to increment address counter after write
-  lcdPutCommand (lcd, LCD_CDSHIFT | LCD_CDSHIFT_RL) ;  // set display shift to right-to-left
-  // ------
-  // -----------------------------------------------------------------------------
-  // INLINED:
-  //fprintf(stderr,"Printing welcome message ...\n");
-  lcdPosition (lcd, 0, 0) ; lcdPuts (lcd, string) ;
-  lcdPosition (lcd, 0, 1) ; lcdPuts (lcd, string2) ;
-
-  //waitForEnter () ; // -------------------------------------------------------
-
-  //lcdClear    (lcd) ;
-
-  // TODO: print a longer message and make it scroll on the display
+  lcdWriteLines (lcd, string, string2) ;
 
   return 0 ;
 }
@@ -510,16 +150,6 @@ int failure (int fatal, const char *message, ...)
   return 0 ;
 }
 
-void delay (unsigned int howLong)
-{
-  struct timespec sleeper, dummy ;
-
-  sleeper.tv_sec  = (time_t)(howLong / 1000) ;
-  sleeper.tv_nsec = (long)(howLong % 1000) * 1000000 ;
-
-  nanosleep (&sleeper, &dummy) ;
-}
-
 int *input(int length, int numRange) {
   int pinLED = LED, pinButton = BUTTON,pinLEDR = LEDR;
   int fSel, shift, pin,  clrOff, setOff, off;
@@ -658,24 +288,10 @@ int main (int argc, char **argv)
 
   printf ("Raspberry Pi button controlled LED (button in %d, led out %d)\n", BUTTON, LED) ;
 
-  if (geteuid () != 0)
-    fprintf (stderr, "setup: Must be root. (Did you forget sudo?)\n") ;
-
   // -----------------------------------------------------------------------------
-  // constants for RPi2
-  gpiobase = 0x3F200000 ;
-
-  // -----------------------------------------------------------------------------
-  // memory mapping 
-  // Open the master /dev/memory device
-
-  if ((fd = open ("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC) ) < 0)
-    return failure (FALSE, "setup: Unable to open /dev/mem: %s\n", strerror (errno)) ;
-
-  // GPIO:
-  gpio = (uint32_t *)mmap(0, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, gpiobase) ;
-  if ((int32_t)gpio == -1)
-    return failure (FALSE, "setup: mmap (GPIO) failed: %s\n", strerror (errno)) ;
+  // Real registers via /dev/mem on the Pi, or the simulated register file
+  if (gpioSetup (NULL) != 0)
+    return failure (FALSE, "setup: Unable to open GPIO (%s): %s\n", gpioBackendName (), strerror (errno)) ;
 
   // -----------------------------------------------------------------------------
   // setting the mode
@@ -0,0 +1,211 @@
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "timing.h"
+
+/*
+ * nanosleep() on Linux routinely wakes 50-100uS late, which is longer than
+ * most of the LCD waits themselves. Short waits therefore spin on the raw
+ * monotonic clock, and longer ones sleep for all but DELAY_SPIN_SLACK and
+ * spin out the rest.
+ */
+
+#ifdef CLOCK_MONOTONIC_RAW
+#define	DELAY_CLOCK		CLOCK_MONOTONIC_RAW
+#else
+#define	DELAY_CLOCK		CLOCK_MONOTONIC
+#endif
+
+static struct delayStats stats ;
+
+static int      fakeOn ;
+static uint64_t fakeNs ;
+
+static uint64_t nowNs (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (DELAY_CLOCK, &ts) ;
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+}
+
+static void spinUntil (uint64_t end)
+{
+  while (nowNs () < end)
+    ;
+}
+
+static void record (uint64_t start, unsigned int howLong)
+{
+  uint64_t over = nowNs () - start ;
+  uint64_t max ;
+
+  over = over > howLong * 1000ULL ? over - howLong * 1000ULL : 0 ;
+
+  // delays come from the feedback thread as well as the main loop
+  __atomic_fetch_add (&stats.calls, 1, __ATOMIC_RELAXED) ;
+  __atomic_fetch_add (&stats.requestedNs, howLong * 1000ULL, __ATOMIC_RELAXED) ;
+  __atomic_fetch_add (&stats.overshootNs, over, __ATOMIC_RELAXED) ;
+  max = __atomic_load_n (&stats.maxOvershootNs, __ATOMIC_RELAXED) ;
+  while (over > max && !__atomic_compare_exchange_n (&stats.maxOvershootNs, &max, over, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+/*
+ * Busy-waits for @howLong microseconds. Burns the CPU, so only for short
+ * waits.
+ */
+void delayMicrosecondsHard (unsigned int howLong)
+{
+  if (timeIsFake ())
+  {
+    timeAdvance (howLong * 1000ULL) ;
+    return ;
+  }
+  spinUntil (nowNs () + howLong * 1000ULL) ;
+}
+
+void delayMicroseconds (unsigned int howLong)
+{
+  struct timespec sleeper ;
+  uint64_t start, end ;
+  unsigned int sleepFor ;
+
+  /**/ if (howLong ==   0)
+    return ;
+  else if (timeIsFake ())
+  {
+    timeAdvance (howLong * 1000ULL) ;
+    return ;
+  }
+
+  start = nowNs () ;
+  end   = start + howLong * 1000ULL ;
+
+  if (howLong >= DELAY_SPIN_LIMIT)
+  {
+    sleepFor = howLong - DELAY_SPIN_SLACK ;
+    sleeper.tv_sec  = sleepFor / 1000000 ;
+    sleeper.tv_nsec = (long)(sleepFor % 1000000) * 1000L ;
+    nanosleep (&sleeper, NULL) ;
+  }
+  spinUntil (end) ;
+
+  record (start, howLong) ;
+}
+
+void delay (unsigned int howLong)
+{
+  delayUntil (deadlineAfterMs (howLong)) ;
+}
+
+/*
+ * How late delayMicroseconds() has returned since the last reset.
+ */
+void delayStatsGet (struct delayStats *out)
+{
+  out->calls          = __atomic_load_n (&stats.calls,          __ATOMIC_RELAXED) ;
+  out->requestedNs    = __atomic_load_n (&stats.requestedNs,    __ATOMIC_RELAXED) ;
+  out->overshootNs    = __atomic_load_n (&stats.overshootNs,    __ATOMIC_RELAXED) ;
+  out->maxOvershootNs = __atomic_load_n (&stats.maxOvershootNs, __ATOMIC_RELAXED) ;
+}
+
+void delayStatsReset (void)
+{
+  __atomic_store_n (&stats.calls,          0, __ATOMIC_RELAXED) ;
+  __atomic_store_n (&stats.requestedNs,    0, __ATOMIC_RELAXED) ;
+  __atomic_store_n (&stats.overshootNs,    0, __ATOMIC_RELAXED) ;
+  __atomic_store_n (&stats.maxOvershootNs, 0, __ATOMIC_RELAXED) ;
+}
+
+/* ------------------------------------------------------- */
+/* Monotonic deadlines, and the fake clock */
+
+uint64_t timeNowNs (void)
+{
+  struct timespec ts ;
+
+  if (timeIsFake ())
+    return __atomic_load_n (&fakeNs, __ATOMIC_ACQUIRE) ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+}
+
+/*
+ * From now on the clock reads @startNs and only moves forward through
+ * timeAdvance() or by sleeping.
+ */
+void timeFake (uint64_t startNs)
+{
+  __atomic_store_n (&fakeNs, startNs, __ATOMIC_RELEASE) ;
+  __atomic_store_n (&fakeOn, 1, __ATOMIC_RELEASE) ;
+}
+
+void timeReal (void)
+{
+  __atomic_store_n (&fakeOn, 0, __ATOMIC_RELEASE) ;
+}
+
+int timeIsFake (void)
+{
+  return __atomic_load_n (&fakeOn, __ATOMIC_ACQUIRE) ;
+}
+
+void timeAdvance (uint64_t ns)
+{
+  __atomic_fetch_add (&fakeNs, ns, __ATOMIC_ACQ_REL) ;
+}
+
+uint64_t deadlineAfterMs (unsigned int ms)
+{
+  return timeNowNs () + ms * 1000000ULL ;
+}
+
+int deadlinePassed (uint64_t deadline)
+{
+  return timeNowNs () >= deadline ;
+}
+
+/*
+ * The timeout to give poll() to wake up at @deadline: milliseconds left,
+ * rounded up so it never wakes early, and -1 for no deadline (0). With the
+ * fake clock it is 0, as real time passing wouldn't move it; the caller
+ * then moves it with delayUntil().
+ */
+int deadlinePollMs (uint64_t deadline)
+{
+  uint64_t now ;
+
+  if (deadline == 0)
+    return -1 ;
+  if (timeIsFake ())
+    return 0 ;
+
+  now = timeNowNs () ;
+  return deadline > now ? (int)((deadline - now + 999999) / 1000000) : 0 ;
+}
+
+/*
+ * Sleeps until the clock reads @deadline. Sleeping to an absolute time
+ * means a series of delays doesn't add up the oversleep of each one.
+ */
+void delayUntil (uint64_t deadline)
+{
+  struct timespec ts ;
+  uint64_t now ;
+
+  if (timeIsFake ())
+  {
+    now = __atomic_load_n (&fakeNs, __ATOMIC_ACQUIRE) ;
+    while (now < deadline && !__atomic_compare_exchange_n (&fakeNs, &now, deadline, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      ;
+    return ;
+  }
+
+  ts.tv_sec  = deadline / 1000000000ULL ;
+  ts.tv_nsec = deadline % 1000000000ULL ;
+  while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    ;
+}
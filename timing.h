@@ -0,0 +1,53 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+
+/*
+ * Sleeping for a number of milli- or microseconds, as in wiringPi.
+ *
+ * delayMicroseconds() spins for waits under DELAY_SPIN_LIMIT; longer ones
+ * nanosleep() until DELAY_SPIN_SLACK before the end and spin the rest, so
+ * they come back on time instead of a scheduler tick late.
+ */
+
+#define	DELAY_SPIN_LIMIT	200	// uS
+#define	DELAY_SPIN_SLACK	100	// uS, must be below DELAY_SPIN_LIMIT
+
+// Totals over every delayMicroseconds() call, in nanoseconds
+struct delayStats
+{
+  uint64_t calls ;
+  uint64_t requestedNs ;
+  uint64_t overshootNs ;
+  uint64_t maxOvershootNs ;
+} ;
+
+void delay                 (unsigned int howLong) ;
+void delayMicroseconds     (unsigned int howLong) ;
+void delayMicrosecondsHard (unsigned int howLong) ;
+
+void delayStatsGet   (struct delayStats *stats) ;
+void delayStatsReset (void) ;
+
+/*
+ * Deadlines on CLOCK_MONOTONIC, in nanoseconds. Unlike time(NULL) they
+ * have no one-second steps and don't jump with the wall clock.
+ *
+ * timeFake() swaps in a clock that only moves when told to: sleeping until
+ * a deadline (delay(), delayUntil(), ...) jumps straight to it, so timing
+ * can be checked, or a game simulated, without waiting.
+ */
+
+uint64_t timeNowNs      (void) ;
+void     timeFake       (uint64_t startNs) ;
+void     timeReal       (void) ;
+int      timeIsFake     (void) ;
+void     timeAdvance    (uint64_t ns) ;
+
+uint64_t deadlineAfterMs (unsigned int ms) ;
+int      deadlinePassed  (uint64_t deadline) ;
+int      deadlinePollMs  (uint64_t deadline) ;
+void     delayUntil      (uint64_t deadline) ;
+
+#endif